@@ -0,0 +1,352 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <climits>
+#include <boost/variant.hpp>
+#include <boost/functional/hash.hpp>
+#include "syntax.hpp"
+
+namespace syntax
+{
+
+namespace detail
+{
+
+// a scope maps each bound name to the stack of binding depths at which it was bound
+class scope
+{
+  public:
+    inline std::size_t depth(void) const
+    {
+      return m_depth;
+    } // end depth()
+
+    inline void bind(const std::string &name)
+    {
+      m_bindings[name].push_back(m_depth++);
+    } // end bind()
+
+    inline void unbind(const std::string &name)
+    {
+      auto iter = m_bindings.find(name);
+      iter->second.pop_back();
+      if(iter->second.empty())
+      {
+        m_bindings.erase(iter);
+      } // end if
+      --m_depth;
+    } // end unbind()
+
+    // returns the depth at which name was bound, or -1 if it is free
+    inline long lookup(const std::string &name) const
+    {
+      auto iter = m_bindings.find(name);
+      return iter == m_bindings.end() ? -1 : static_cast<long>(iter->second.back());
+    } // end lookup()
+
+    inline scope()
+      : m_depth(0)
+    {}
+
+  private:
+    std::size_t m_depth;
+    std::map<std::string, std::vector<std::size_t>> m_bindings;
+}; // end scope
+
+// hashes a term with bound identifiers replaced by their de Bruijn indices
+// as a side effect, records the hash of every closed compound subterm
+class alpha_hasher
+  : public boost::static_visitor<std::pair<std::size_t,long>>
+{
+  public:
+    // the second half of a result is the shallowest binding depth referenced
+    // by the term, or -1 if it references a free identifier
+    inline static long unreferenced(void)
+    {
+      return LONG_MAX;
+    } // end unreferenced()
+
+    inline alpha_hasher(std::unordered_map<const void*, std::size_t> *closed_terms = 0)
+      : m_closed_terms(closed_terms)
+    {}
+
+    inline result_type operator()(const node &n)
+    {
+      auto result = boost::apply_visitor(*this, n);
+
+      // a term is closed when every identifier it references is bound within it
+      // XXX which() > 1 skips integer_literal and identifier
+      if(m_closed_terms && n.which() > 1 && result.second >= static_cast<long>(m_scope.depth()))
+      {
+        (*m_closed_terms)[address(n)] = result.first;
+      } // end if
+
+      return result;
+    } // end operator()()
+
+    inline result_type operator()(const integer_literal &il)
+    {
+      std::size_t seed = 0;
+      boost::hash_combine(seed, 0);
+      boost::hash_combine(seed, il.value());
+      return result_type(seed, unreferenced());
+    } // end operator()()
+
+    inline result_type operator()(const identifier &id)
+    {
+      std::size_t seed = 0;
+      long depth = m_scope.lookup(id.name());
+
+      if(depth < 0)
+      {
+        boost::hash_combine(seed, 1);
+        boost::hash_combine(seed, id.name());
+      } // end if
+      else
+      {
+        // the de Bruijn index of the identifier
+        boost::hash_combine(seed, 2);
+        boost::hash_combine(seed, m_scope.depth() - depth);
+      } // end else
+
+      return result_type(seed, depth);
+    } // end operator()()
+
+    inline result_type operator()(const apply &app)
+    {
+      auto fn  = (*this)(app.function());
+      auto arg = (*this)(app.argument());
+      return combine(3, fn, arg);
+    } // end operator()()
+
+    inline result_type operator()(const lambda &l)
+    {
+      m_scope.bind(l.parameter());
+      auto body = (*this)(l.body());
+      m_scope.unbind(l.parameter());
+      return combine(4, body, result_type(0, unreferenced()));
+    } // end operator()()
+
+    inline result_type operator()(const let &l)
+    {
+      auto def = (*this)(l.definition());
+      m_scope.bind(l.name());
+      auto body = (*this)(l.body());
+      m_scope.unbind(l.name());
+      return combine(5, def, body);
+    } // end operator()()
+
+    inline result_type operator()(const letrec &l)
+    {
+      m_scope.bind(l.name());
+      auto def  = (*this)(l.definition());
+      auto body = (*this)(l.body());
+      m_scope.unbind(l.name());
+      return combine(6, def, body);
+    } // end operator()()
+
+    inline result_type operator()(const letrec_group &l)
+    {
+      auto &bindings = l.bindings();
+      for(auto i = bindings.begin(); i != bindings.end(); ++i) m_scope.bind(i->first);
+
+      auto result = result_type(bindings.size(), unreferenced());
+      for(auto i = bindings.begin(); i != bindings.end(); ++i)
+      {
+        result = combine(7, result, (*this)(i->second));
+      } // end for i
+      result = combine(7, result, (*this)(l.body()));
+
+      for(auto i = bindings.rbegin(); i != bindings.rend(); ++i) m_scope.unbind(i->first);
+      return result;
+    } // end operator()()
+
+    inline result_type operator()(const record &r)
+    {
+      auto &fields = r.fields();
+
+      auto result = result_type(fields.size(), unreferenced());
+      for(auto i = fields.begin(); i != fields.end(); ++i)
+      {
+        result = combine(8, result, result_type(boost::hash_value(i->first), unreferenced()));
+        result = combine(8, result, (*this)(i->second));
+      } // end for i
+
+      return result;
+    } // end operator()()
+
+    inline result_type operator()(const selection &s)
+    {
+      return combine(9, (*this)(s.record()), result_type(boost::hash_value(s.label()), unreferenced()));
+    } // end operator()()
+
+  private:
+    inline static result_type combine(const std::size_t tag, const result_type &x, const result_type &y)
+    {
+      std::size_t seed = 0;
+      boost::hash_combine(seed, tag);
+      boost::hash_combine(seed, x.first);
+      boost::hash_combine(seed, y.first);
+      return result_type(seed, std::min(x.second, y.second));
+    } // end combine()
+
+    scope m_scope;
+    std::unordered_map<const void*, std::size_t> *m_closed_terms;
+}; // end alpha_hasher
+
+class alpha_comparator
+  : public boost::static_visitor<bool>
+{
+  public:
+    inline bool operator()(const node &x, const node &y)
+    {
+      return boost::apply_visitor(*this, x, y);
+    } // end operator()()
+
+    template<typename T, typename U>
+      inline bool operator()(const T &, const U &)
+    {
+      return false;
+    } // end operator()()
+
+    inline bool operator()(const integer_literal &x, const integer_literal &y)
+    {
+      return x.value() == y.value();
+    } // end operator()()
+
+    inline bool operator()(const identifier &x, const identifier &y)
+    {
+      long x_depth = m_x_scope.lookup(x.name());
+      long y_depth = m_y_scope.lookup(y.name());
+
+      if(x_depth < 0 || y_depth < 0)
+      {
+        // free identifiers must agree by name
+        return x_depth == y_depth && x.name() == y.name();
+      } // end if
+
+      return m_x_scope.depth() - x_depth == m_y_scope.depth() - y_depth;
+    } // end operator()()
+
+    inline bool operator()(const apply &x, const apply &y)
+    {
+      return (*this)(x.function(), y.function()) && (*this)(x.argument(), y.argument());
+    } // end operator()()
+
+    inline bool operator()(const lambda &x, const lambda &y)
+    {
+      m_x_scope.bind(x.parameter());
+      m_y_scope.bind(y.parameter());
+      bool result = (*this)(x.body(), y.body());
+      m_x_scope.unbind(x.parameter());
+      m_y_scope.unbind(y.parameter());
+      return result;
+    } // end operator()()
+
+    inline bool operator()(const let &x, const let &y)
+    {
+      if(!(*this)(x.definition(), y.definition())) return false;
+
+      m_x_scope.bind(x.name());
+      m_y_scope.bind(y.name());
+      bool result = (*this)(x.body(), y.body());
+      m_x_scope.unbind(x.name());
+      m_y_scope.unbind(y.name());
+      return result;
+    } // end operator()()
+
+    inline bool operator()(const letrec &x, const letrec &y)
+    {
+      m_x_scope.bind(x.name());
+      m_y_scope.bind(y.name());
+      bool result = (*this)(x.definition(), y.definition()) && (*this)(x.body(), y.body());
+      m_x_scope.unbind(x.name());
+      m_y_scope.unbind(y.name());
+      return result;
+    } // end operator()()
+
+    inline bool operator()(const letrec_group &x, const letrec_group &y)
+    {
+      auto &xs = x.bindings();
+      auto &ys = y.bindings();
+      if(xs.size() != ys.size()) return false;
+
+      for(std::size_t i = 0; i < xs.size(); ++i)
+      {
+        m_x_scope.bind(xs[i].first);
+        m_y_scope.bind(ys[i].first);
+      } // end for i
+
+      bool result = true;
+      for(std::size_t i = 0; result && i < xs.size(); ++i)
+      {
+        result = (*this)(xs[i].second, ys[i].second);
+      } // end for i
+      result = result && (*this)(x.body(), y.body());
+
+      for(std::size_t i = xs.size(); i > 0; --i)
+      {
+        m_x_scope.unbind(xs[i-1].first);
+        m_y_scope.unbind(ys[i-1].first);
+      } // end for i
+
+      return result;
+    } // end operator()()
+
+    inline bool operator()(const record &x, const record &y)
+    {
+      auto &xs = x.fields();
+      auto &ys = y.fields();
+      if(xs.size() != ys.size()) return false;
+
+      for(std::size_t i = 0; i < xs.size(); ++i)
+      {
+        if(xs[i].first != ys[i].first || !(*this)(xs[i].second, ys[i].second)) return false;
+      } // end for i
+
+      return true;
+    } // end operator()()
+
+    inline bool operator()(const selection &x, const selection &y)
+    {
+      return x.label() == y.label() && (*this)(x.record(), y.record());
+    } // end operator()()
+
+  private:
+    scope m_x_scope, m_y_scope;
+}; // end alpha_comparator
+
+} // end detail
+
+// returns a hash of n which is insensitive to the names of bound identifiers
+inline std::size_t alpha_hash(const node &n)
+{
+  return detail::alpha_hasher()(n).first;
+} // end alpha_hash()
+
+// returns true if x and y differ only in the names of bound identifiers
+inline bool alpha_equivalent(const node &x, const node &y)
+{
+  return detail::alpha_comparator()(x, y);
+} // end alpha_equivalent()
+
+// returns true if n references no free identifiers
+inline bool closed(const node &n)
+{
+  return detail::alpha_hasher()(n).second != -1;
+} // end closed()
+
+// maps the address of every closed compound subterm of n to its alpha_hash()
+// in a single pass over n
+inline std::unordered_map<const void*, std::size_t> closed_subterms(const node &n)
+{
+  std::unordered_map<const void*, std::size_t> result;
+  detail::alpha_hasher hasher(&result);
+  hasher(n);
+  return result;
+} // end closed_subterms()
+
+} // end syntax
@@ -0,0 +1,277 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <new>
+#include <iomanip>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include "unification.hpp"
+#include "syntax.hpp"
+#include "parser.hpp"
+#include "inference.hpp"
+#include "prelude.hpp"
+#include "trace.hpp"
+#include "fuzzer.hpp"
+#include "perf_counters.hpp"
+
+// benchmarks inference of programs against the demo's prelude, and the
+// unification of traces recorded with demo --trace, reading the hardware's
+// performance counters around each benchmark
+//
+//   $ ./bench [--runs n] benchmarks/*.hm demo.trace
+//
+// a file ending in .hm is a program, and is reported per AST node. any other
+// file is a trace, replayed through a unification::workspace, and is reported
+// per constraint. each line of the report is tab-separated
+//
+//   benchmark  unit  metric  per run  per unit
+//
+// so that the reports of two builds can be compared with diff or join. the
+// metrics are ns, the hardware counters the kernel allows this process to
+// open, and the calls and bytes of operator new. where perf_event_open is
+// unavailable, as in many containers, only time and allocations are reported
+//
+// without --runs, each benchmark repeats for at least 100ms
+
+// every allocation of the program is counted
+void *operator new(std::size_t n)
+{
+  benchmark::allocations::note(n);
+  if(void *result = std::malloc(n ? n : 1)) return result;
+  throw std::bad_alloc();
+}
+
+void *operator new(std::size_t n, std::align_val_t alignment)
+{
+  benchmark::allocations::note(n);
+  std::size_t a = static_cast<std::size_t>(alignment);
+  if(a < sizeof(void*)) a = sizeof(void*);
+  void *result = 0;
+  if(posix_memalign(&result, a, n ? n : 1) == 0) return result;
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void *p, std::align_val_t) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept
+{
+  std::free(p);
+}
+
+struct measurement
+{
+  std::size_t                 m_runs;
+  double                      m_ns;
+  std::uint64_t               m_allocations;
+  std::uint64_t               m_allocated_bytes;
+  std::vector<std::uint64_t>  m_counters;
+}; // end measurement
+
+// calls f runs times, or for at least 100ms if runs is 0
+template<typename Function>
+inline measurement measure(benchmark::hardware_counters &counters, std::size_t runs, Function f)
+{
+  using namespace benchmark;
+
+  // warm up, and don't count any allocations made once, like a workspace's
+  f();
+
+  measurement result;
+  result.m_runs = 0;
+
+  auto allocations_before = allocations::count().load();
+  auto bytes_before = allocations::bytes().load();
+  counters.start();
+  auto start = std::chrono::steady_clock::now();
+  std::chrono::duration<double, std::nano> elapsed(0);
+
+  while(runs ? result.m_runs < runs : elapsed.count() < 1e8)
+  {
+    f();
+    ++result.m_runs;
+    elapsed = std::chrono::steady_clock::now() - start;
+  } // end while
+
+  counters.stop();
+
+  result.m_ns = elapsed.count();
+  result.m_allocations = allocations::count().load() - allocations_before;
+  result.m_allocated_bytes = allocations::bytes().load() - bytes_before;
+  for(int e = 0; e < hardware_counters::num_events; ++e)
+  {
+    result.m_counters.push_back(counters.value(hardware_counters::event(e)));
+  } // end for e
+
+  return result;
+} // end measure()
+
+inline void report(const std::string &benchmark,
+                   const char *unit,
+                   std::size_t units,
+                   const measurement &m,
+                   const benchmark::hardware_counters &counters)
+{
+  using benchmark::hardware_counters;
+
+  auto row = [&](const char *metric, double total)
+  {
+    double per_run = total / m.m_runs;
+    std::cout << benchmark << "\t" << unit << "\t" << metric << "\t" << per_run << "\t" << per_run / (units ? units : 1) << std::endl;
+  };
+
+  row(unit, static_cast<double>(units) * m.m_runs);
+  row("ns", m.m_ns);
+  for(int e = 0; e < hardware_counters::num_events; ++e)
+  {
+    auto event = hardware_counters::event(e);
+    if(counters.available(event))
+    {
+      row(hardware_counters::name(event), m.m_counters[e]);
+    } // end if
+  } // end for e
+  row("allocations", m.m_allocations);
+  row("allocated_bytes", m.m_allocated_bytes);
+} // end report()
+
+inline bool ends_with(const std::string &s, const std::string &suffix)
+{
+  return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+} // end ends_with()
+
+inline void bench_program(const std::string &filename, std::istream &is, std::size_t runs, benchmark::hardware_counters &counters)
+{
+  std::stringstream contents;
+  contents << is.rdbuf();
+  auto program = syntax::parse(contents.str());
+  auto env = inference::prelude();
+
+  // an ill-typed program is as good a benchmark as any, so its error is
+  // just caught
+  auto m = measure(counters, runs, [&]
+  {
+    try
+    {
+      inference::infer_type(program, env);
+    } // end try
+    catch(const std::exception &) {}
+  });
+
+  report(filename, "nodes", fuzzing::size(program), m, counters);
+} // end bench_program()
+
+inline void bench_trace(const std::string &filename, std::istream &is, std::size_t runs, benchmark::hardware_counters &counters)
+{
+  using namespace unification;
+
+  // each call is tagged with the inference which made it
+  std::vector<std::pair<std::size_t, std::vector<constraint>>> calls;
+  std::size_t num_constraints = 0;
+
+  trace_reader reader(is);
+  std::vector<constraint> call;
+  while(reader.next(call))
+  {
+    num_constraints += call.size();
+    calls.push_back(std::make_pair(reader.inference(), call));
+  } // end while
+
+  workspace w;
+  auto m = measure(counters, runs, [&]
+  {
+    substitution_map substitution;
+    std::size_t inference = 0;
+
+    for(auto i = calls.begin(); i != calls.end(); ++i)
+    {
+      // calls of one inference share a substitution, as they did when recorded
+      if(i->first != inference)
+      {
+        substitution.clear();
+        inference = i->first;
+      } // end if
+
+      try
+      {
+        w.unify(i->second.begin(), i->second.end(), substitution);
+      } // end try
+      catch(const type_mismatch &) {}
+      catch(const recursive_unification &) {}
+    } // end for i
+  });
+
+  report(filename, "constraints", num_constraints, m, counters);
+} // end bench_trace()
+
+int main(int argc, char **argv)
+{
+  const char *program = argv[0];
+  std::size_t runs = 0;
+
+  if(argc > 2 && !std::strcmp(argv[1], "--runs"))
+  {
+    runs = std::strtoull(argv[2], 0, 10);
+    argc -= 2;
+    argv += 2;
+  } // end if
+
+  if(argc < 2)
+  {
+    std::cerr << "usage: " << program << " [--runs n] file..." << std::endl;
+    return 1;
+  } // end if
+
+  benchmark::hardware_counters counters;
+  if(!counters.any_available())
+  {
+    std::cerr << "hardware counters are unavailable; reporting time and allocations only" << std::endl;
+  } // end if
+
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << "benchmark\tunit\tmetric\tper run\tper unit" << std::endl;
+
+  for(int i = 1; i < argc; ++i)
+  {
+    std::ifstream file(argv[i], std::ios::binary);
+    if(!file)
+    {
+      std::cerr << "couldn't open " << argv[i] << ": " << std::strerror(errno) << std::endl;
+      return 1;
+    } // end if
+
+    try
+    {
+      if(ends_with(argv[i], ".hm"))
+      {
+        bench_program(argv[i], file, runs, counters);
+      } // end if
+      else
+      {
+        bench_trace(argv[i], file, runs, counters);
+      } // end else
+    } // end try
+    catch(const std::exception &e)
+    {
+      std::cerr << argv[i] << ": " << e.what() << std::endl;
+      return 1;
+    } // end catch
+  } // end for i
+
+  return 0;
+}
@@ -0,0 +1,118 @@
+#include <fstream>
+#include <cstring>
+#include <cerrno>
+#include <memory>
+#include "unification.hpp"
+#include "syntax.hpp"
+#include "parser.hpp"
+#include "inference.hpp"
+#include "pipeline.hpp"
+#include "prelude.hpp"
+#include "pretty_printer.hpp"
+
+// checks a program of top-level declarations against the demo's prelude,
+// printing the type of each binding as soon as its declaration is checked
+//
+//   $ ./check program.hm
+//   $ ./check < program.hm
+//
+// --profile prefix writes the cost of each binding to prefix.<metric>.folded,
+// for each of inference::profiler's metrics, in the format of flamegraph.pl
+//
+//   $ ./check --profile program program.hm
+//   $ flamegraph.pl program.wall_time.folded > program.svg
+
+// writes a collapsed-stack file for each metric
+inline bool write_profile(inference::profiler &p, const std::string &prefix)
+{
+  for(int m = 0; m < inference::profiler::num_metrics; ++m)
+  {
+    auto metric = inference::profiler::metric(m);
+    auto filename = prefix + "." + inference::profiler::name(metric) + ".folded";
+
+    std::ofstream os(filename);
+    p.write(os, metric);
+    if(!os)
+    {
+      std::cerr << "couldn't write " << filename << ": " << std::strerror(errno) << std::endl;
+      return false;
+    } // end if
+  } // end for m
+
+  return true;
+} // end write_profile()
+
+int main(int argc, char **argv)
+{
+  const char *program = argv[0];
+
+  std::unique_ptr<inference::profiler> profile;
+  std::string profile_prefix;
+  if(argc > 2 && !std::strcmp(argv[1], "--profile"))
+  {
+    profile.reset(new inference::profiler("check"));
+    profile_prefix = argv[2];
+    argc -= 2;
+    argv += 2;
+  } // end if
+
+  if(argc > 2)
+  {
+    std::cerr << "usage: " << program << " [--profile prefix] [file]" << std::endl;
+    return 1;
+  } // end if
+
+  // after an error the parser thread may still be reading when main returns,
+  // so the file, like std::cin, is never destroyed
+  std::istream *is = &std::cin;
+  if(argc == 2)
+  {
+    auto file = new std::ifstream(argv[1]);
+    if(!*file)
+    {
+      std::cerr << "couldn't open " << argv[1] << ": " << std::strerror(errno) << std::endl;
+      return 1;
+    } // end if
+
+    is = file;
+  } // end if
+
+  // the parser reads on its own thread, so reading mustn't flush std::cout
+  std::cin.tie(0);
+
+  inference::declaration_pipeline pipeline(*is, inference::prelude(), 64, profile.get());
+
+  try
+  {
+    pipeline.run([](const std::string &name, const inference::type &t)
+    {
+      std::cout << name << " : ";
+      pretty_printer pp(std::cout);
+      pp << t << "\n";
+    });
+  } // end try
+  catch(const unification::recursive_unification &e)
+  {
+    pretty_printer pp(std::cerr);
+    pp << "error: " << e.what() << ": " << e.x << " in " << e.y << "\n";
+    return 1;
+  } // end catch
+  catch(const unification::type_mismatch &e)
+  {
+    pretty_printer pp(std::cerr);
+    pp << "error: " << e.what() << ": " << e.x << " != " << e.y << "\n";
+    return 1;
+  } // end catch
+  catch(const std::runtime_error &e)
+  {
+    std::cerr << "error: " << e.what() << std::endl;
+    return 1;
+  } // end catch
+
+  if(profile && !write_profile(*profile, profile_prefix))
+  {
+    return 1;
+  } // end if
+
+  return 0;
+}
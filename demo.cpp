@@ -1,133 +1,28 @@
-#include <sstream>
+#include <fstream>
+#include <cstring>
+#include <memory>
 #include "unification.hpp"
+#include "trace.hpp"
 #include "syntax.hpp"
 #include "inference.hpp"
-
-namespace types
-{
-  static const int integer  = 0;
-  static const int boolean  = 1;
-  static const int function = 2;
-  static const int pair     = 3;
-}
-
-class pretty_printer
-  : public boost::static_visitor<pretty_printer&>
-{
-  public:
-    inline pretty_printer(std::ostream &os)
-      : m_os(os),
-        m_next_name('a')
-    {}
-
-    inline pretty_printer &operator()(const unification::type_variable &x)
-    {
-      if(!m_names.count(x))
-      {
-        std::ostringstream os;
-        os << m_next_name++;
-        m_names[x] = os.str();
-      } // end if
-
-      m_os << m_names[x];
-      return *this;
-    }
-
-    inline pretty_printer &operator()(const unification::type_operator &x)
-    {
-      switch(x.kind())
-      {
-        case types::integer:
-        {
-          m_os << "int";
-          break;
-        } // end case
-        case types::boolean:
-        {
-          m_os << "bool";
-          break;
-        } // end case
-        case types::function:
-        {
-          m_os << "(";
-          *this << x[0];
-          m_os << " -> ";
-          *this << x[1];
-          m_os << ")";
-          break;
-        } // end case
-        case types::pair:
-        {
-          m_os << "(";
-          *this << x[0];
-          m_os << " * ";
-          *this << x[1];
-          m_os << ")";
-          break;
-        } // end case
-        default:
-        {
-        } // end default
-      } // end switch
-
-      return *this;
-    }
-
-    inline pretty_printer &operator<<(const unification::type &x)
-    {
-      return boost::apply_visitor(*this, x);
-    }
-
-    inline pretty_printer &operator<<(std::ostream & (*fp)(std::ostream &))
-    {
-      fp(m_os);
-      return *this;
-    }
-
-    template<typename T>
-    inline pretty_printer &operator<<(const T &x)
-    {
-      m_os << x;
-      return *this;
-    }
-
-  private:
-    std::ostream &m_os;
-
-    std::map<unification::type_variable, std::string> m_names;
-    char m_next_name;
-};
-
-namespace unification
-{
-
-inline std::ostream &operator<<(std::ostream &os, const type_variable &x)
-{
-  pretty_printer pp(os);
-  pp << type(x);
-  return os;
-}
-
-inline std::ostream &operator<<(std::ostream &os, const type_operator &x)
-{
-  pretty_printer pp(os);
-  pp << type(x);
-  return os;
-}
-
-}
+#include "prelude.hpp"
+#include "pretty_printer.hpp"
+#include "static_syntax.hpp"
+#include "static_inference.hpp"
 
 struct try_to_infer
 {
-  inline try_to_infer(const inference::environment &e)
-    : env(e)
+  inline try_to_infer(const inference::environment &e,
+                      unification::trace_writer *t = 0)
+    : env(e),
+      trace(t)
   {}
 
   inline void operator()(const syntax::node &n) const
   {
     try
     {
-      auto result = inference::infer_type(n, env);
+      auto result = trace ? inference::infer_type(n, env, *trace) : inference::infer_type(n, env);
 
       std::cout << n << " : ";
       pretty_printer pp(std::cout);
@@ -152,39 +47,97 @@ struct try_to_infer
   } // end operator()
 
   const inference::environment &env;
+  unification::trace_writer *trace;
 };
 
-int main()
+// the examples which type check, typed by the compiler
+namespace static_examples
+{
+
+using namespace static_syntax;
+using namespace static_inference::names;
+
+inline constexpr char factorial_[] = "factorial";
+inline constexpr char n[]          = "n";
+inline constexpr char f[]          = "f";
+inline constexpr char g[]          = "g";
+inline constexpr char x[]          = "x";
+inline constexpr char y[]          = "y";
+inline constexpr char arg[]        = "arg";
+
+typedef letrec<factorial_,
+  lambda<n,
+    apply<
+      apply<
+        apply<identifier<cond>, apply<identifier<zero>, identifier<n>>>,
+        integer_literal<1>
+      >,
+      apply<
+        apply<identifier<times>, identifier<n>>,
+        apply<identifier<factorial_>, apply<identifier<pred>, identifier<n>>>
+      >
+    >
+  >,
+  apply<identifier<factorial_>, integer_literal<5>>
+> factorial;
+
+typedef let<f,
+  lambda<x, identifier<x>>,
+  apply<
+    apply<identifier<pair>, apply<identifier<f>, integer_literal<4>>>,
+    apply<identifier<f>, identifier<true_>>
+  >
+> polymorphic_let;
+
+typedef let<g, lambda<f, integer_literal<5>>, apply<identifier<g>, identifier<g>>> self_application;
+
+typedef lambda<g,
+  let<f,
+    lambda<x, identifier<g>>,
+    apply<
+      apply<identifier<pair>, apply<identifier<f>, integer_literal<3>>>,
+      apply<identifier<f>, identifier<true_>>
+    >
+  >
+> non_generic;
+
+typedef lambda<f, lambda<g, lambda<arg, apply<identifier<g>, apply<identifier<f>, identifier<arg>>>>>> composition;
+
+typedef lambda<f, apply<identifier<f>, integer_literal<5>>> apply_five;
+
+typedef apply<lambda<y, apply<identifier<y>, integer_literal<1>>>, lambda<x, integer_literal<1>>> apply_one;
+
+} // end static_examples
+
+// returns true if the type the compiler found for Expression is the type
+// inferred for it at run time
+template<typename Expression>
+  inline bool cross_check(const inference::environment &env)
+{
+  auto n = static_syntax::to_node<Expression>();
+
+  std::ostringstream expected, actual;
+  pretty_printer(expected) << inference::infer_type(n, env);
+  pretty_printer(actual) << static_inference::principal_type<Expression>::value();
+
+  if(expected.str() != actual.str())
+  {
+    std::cerr << n << " : inferred " << expected.str() << " at run time but " << actual.str() << " at compile time" << std::endl;
+    return false;
+  } // end if
+
+  return true;
+} // end cross_check()
+
+int main(int argc, char **argv)
 {
   using namespace unification;
   using namespace syntax;
   using namespace inference;
 
-  environment env;
+  environment env = prelude();
   std::vector<node> examples;
 
-  auto var1 = type_variable(env.unique_id());
-  auto var2 = type_variable(env.unique_id());
-  auto var3 = type_variable(env.unique_id());
-
-  env["pair"] = make_function(var1, inference::make_function(var2, pair(var1, var2)));
-  env["true"] = boolean();
-  env["cond"] = make_function(
-                 boolean(),
-                  make_function(
-                    var3, make_function(
-                      var3, var3
-                    )
-                  )
-                );
-  env["zero"] = make_function(integer(), boolean());
-  env["pred"] = make_function(integer(), integer());
-  env["times"] = make_function(
-                   integer(), make_function(
-                     integer(), integer()
-                   )
-                 );
-
   auto pair = apply(apply(identifier("pair"), apply(identifier("f"), integer_literal(4))), apply(identifier("f"), identifier("true")));
 
   // factorial
@@ -293,9 +246,27 @@ int main()
     examples.push_back(example);
   }
 
-  auto f = try_to_infer(env);
+  // demo --trace file records the constraints sent to unify() for replay
+  std::ofstream trace_file;
+  std::unique_ptr<trace_writer> trace;
+  if(argc == 3 && !std::strcmp(argv[1], "--trace"))
+  {
+    trace_file.open(argv[2], std::ios::binary);
+    trace.reset(new trace_writer(trace_file));
+  } // end if
+
+  auto f = try_to_infer(env, trace.get());
   std::for_each(examples.begin(), examples.end(), f);
 
-  return 0;
+  bool agree = true;
+  agree &= cross_check<static_examples::factorial>(env);
+  agree &= cross_check<static_examples::polymorphic_let>(env);
+  agree &= cross_check<static_examples::self_application>(env);
+  agree &= cross_check<static_examples::non_generic>(env);
+  agree &= cross_check<static_examples::composition>(env);
+  agree &= cross_check<static_examples::apply_five>(env);
+  agree &= cross_check<static_examples::apply_one>(env);
+
+  return agree ? 0 : 1;
 }
 
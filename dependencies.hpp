@@ -0,0 +1,252 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <algorithm>
+#include <stdexcept>
+#include <boost/variant.hpp>
+#include "syntax.hpp"
+
+namespace syntax
+{
+
+namespace detail
+{
+
+// collects the identifiers which occur free in a term
+class free_identifier_collector
+  : public boost::static_visitor<>
+{
+  public:
+    inline free_identifier_collector(std::set<std::string> &result)
+      : m_result(result)
+    {}
+
+    inline void operator()(const node &n)
+    {
+      boost::apply_visitor(*this, n);
+    } // end operator()()
+
+    inline void operator()(const integer_literal &)
+    {}
+
+    inline void operator()(const identifier &id)
+    {
+      if(!m_bound.count(id.name()))
+      {
+        m_result.insert(id.name());
+      } // end if
+    } // end operator()()
+
+    inline void operator()(const apply &app)
+    {
+      (*this)(app.function());
+      (*this)(app.argument());
+    } // end operator()()
+
+    inline void operator()(const lambda &l)
+    {
+      bind(l.parameter());
+      (*this)(l.body());
+      unbind(l.parameter());
+    } // end operator()()
+
+    inline void operator()(const let &l)
+    {
+      (*this)(l.definition());
+      bind(l.name());
+      (*this)(l.body());
+      unbind(l.name());
+    } // end operator()()
+
+    inline void operator()(const letrec &l)
+    {
+      bind(l.name());
+      (*this)(l.definition());
+      (*this)(l.body());
+      unbind(l.name());
+    } // end operator()()
+
+    inline void operator()(const letrec_group &l)
+    {
+      auto &bindings = l.bindings();
+
+      for(auto i = bindings.begin(); i != bindings.end(); ++i) bind(i->first);
+
+      for(auto i = bindings.begin(); i != bindings.end(); ++i)
+      {
+        (*this)(i->second);
+      } // end for i
+      (*this)(l.body());
+
+      for(auto i = bindings.begin(); i != bindings.end(); ++i) unbind(i->first);
+    } // end operator()()
+
+    inline void operator()(const record &r)
+    {
+      for(auto i = r.fields().begin(); i != r.fields().end(); ++i)
+      {
+        (*this)(i->second);
+      } // end for i
+    } // end operator()()
+
+    inline void operator()(const selection &s)
+    {
+      (*this)(s.record());
+    } // end operator()()
+
+  private:
+    inline void bind(const std::string &name)
+    {
+      m_bound.insert(name);
+    } // end bind()
+
+    inline void unbind(const std::string &name)
+    {
+      m_bound.erase(m_bound.find(name));
+    } // end unbind()
+
+    std::set<std::string>      &m_result;
+    std::multiset<std::string>  m_bound;
+}; // end free_identifier_collector
+
+} // end detail
+
+// returns the identifiers which occur free in n
+inline std::set<std::string> free_identifiers(const node &n)
+{
+  std::set<std::string> result;
+  detail::free_identifier_collector collect(result);
+  collect(n);
+  return result;
+} // end free_identifiers()
+
+// the dependencies among a group of bindings, split into strongly connected
+// components
+struct dependency_graph
+{
+  // for each binding, the bindings whose names occur free in its definition
+  std::vector<std::vector<std::size_t>> m_edges;
+
+  // the strongly connected components of the graph in topological order:
+  // every binding depends only on bindings in its own or an earlier component
+  std::vector<std::vector<std::size_t>> m_components;
+
+  // for each binding, the index of its component
+  std::vector<std::size_t> m_component_of;
+};
+
+// analyzes the dependencies among the bindings of a letrec_group
+// throws std::runtime_error if a name is bound twice
+inline dependency_graph analyze_dependencies(const std::vector<letrec_group::binding> &bindings)
+{
+  dependency_graph result;
+  const std::size_t n = bindings.size();
+
+  std::map<std::string, std::size_t> index;
+  for(std::size_t i = 0; i < n; ++i)
+  {
+    if(!index.insert(std::make_pair(bindings[i].first, i)).second)
+    {
+      throw std::runtime_error("letrec binds " + bindings[i].first + " more than once");
+    } // end if
+  } // end for i
+
+  result.m_edges.resize(n);
+  for(std::size_t i = 0; i < n; ++i)
+  {
+    auto free = free_identifiers(bindings[i].second);
+    for(auto name = free.begin();
+        name != free.end();
+        ++name)
+    {
+      auto j = index.find(*name);
+      if(j != index.end())
+      {
+        result.m_edges[i].push_back(j->second);
+      } // end if
+    } // end for name
+  } // end for i
+
+  // Tarjan's algorithm, with an explicit stack so that long chains of
+  // dependencies don't exhaust the call stack
+  //
+  // Tarjan's algorithm emits a component only after every component it
+  // depends on, which is the order we want
+  const std::size_t unvisited = static_cast<std::size_t>(-1);
+  std::vector<std::size_t> number(n, unvisited), low(n, 0);
+  std::vector<bool>        on_stack(n, false);
+  std::vector<std::size_t> stack;
+  std::vector<std::pair<std::size_t, std::size_t>> calls;
+  std::size_t next_number = 0;
+
+  result.m_component_of.resize(n);
+
+  for(std::size_t root = 0; root < n; ++root)
+  {
+    if(number[root] != unvisited) continue;
+
+    calls.push_back(std::make_pair(root, 0));
+
+    while(!calls.empty())
+    {
+      std::size_t v = calls.back().first;
+      std::size_t &edge = calls.back().second;
+
+      if(edge == 0 && number[v] == unvisited)
+      {
+        number[v] = low[v] = next_number++;
+        stack.push_back(v);
+        on_stack[v] = true;
+      } // end if
+
+      if(edge < result.m_edges[v].size())
+      {
+        std::size_t w = result.m_edges[v][edge++];
+
+        if(number[w] == unvisited)
+        {
+          calls.push_back(std::make_pair(w, 0));
+        } // end if
+        else if(on_stack[w])
+        {
+          low[v] = std::min(low[v], number[w]);
+        } // end else if
+
+        continue;
+      } // end if
+
+      // v's edges are exhausted
+      if(low[v] == number[v])
+      {
+        std::vector<std::size_t> component;
+        std::size_t w;
+        do
+        {
+          w = stack.back();
+          stack.pop_back();
+          on_stack[w] = false;
+          result.m_component_of[w] = result.m_components.size();
+          component.push_back(w);
+        } while(w != v);
+
+        // keep the bindings of a component in their original order
+        std::sort(component.begin(), component.end());
+        result.m_components.push_back(std::move(component));
+      } // end if
+
+      calls.pop_back();
+      if(!calls.empty())
+      {
+        std::size_t parent = calls.back().first;
+        low[parent] = std::min(low[parent], low[v]);
+      } // end if
+    } // end while
+  } // end for root
+
+  return result;
+} // end analyze_dependencies()
+
+} // end syntax
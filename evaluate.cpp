@@ -0,0 +1,169 @@
+#include <iostream>
+#include <sstream>
+#include <iterator>
+#include <string>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include "unification.hpp"
+#include "syntax.hpp"
+#include "parser.hpp"
+#include "inference.hpp"
+#include "prelude.hpp"
+#include "pretty_printer.hpp"
+#include "monomorphize.hpp"
+#include "evaluator.hpp"
+#include "tree_walker.hpp"
+
+// checks an expression against the demo's prelude, then compiles it to
+// bytecode and runs it, printing its value and type
+//
+//   $ echo 'letrec f = fn n => cond (zero n) 1 (times n (f (pred n))) in f 5' | ./evaluate
+//   120 : int
+//
+// calls which aren't in tail position take registers, not native stack, so
+// deep recursion runs until the registers run out
+//
+//   $ echo 'letrec f = fn n => cond (zero n) 1 (times 1 (f (pred n))) in f 100000' | ./evaluate
+//   1 : int
+//
+// --disassemble prints the bytecode before running it
+//
+// --monomorphize specializes each generalized binding at the types it is
+// used with, and prints the specialized program, before compiling it
+//
+// --bench n runs the program n times with both the bytecode machine and the
+// naive tree walker, checks that they agree, and reports the time each takes
+//
+//   $ ./evaluate --bench 100 < program.hm
+//
+// both print a record's fields in order of their names, however they were
+// written, so that they agree on
+//
+//   $ echo '{y = 1, x = true}' | ./evaluate --bench 3
+//   {x = true, y = 1} : {y : int, x : bool}
+
+// returns the average time of a run in nanoseconds
+template<typename Function>
+inline double time_runs(const std::size_t n, Function f)
+{
+  auto start = std::chrono::steady_clock::now();
+  for(std::size_t i = 0; i < n; ++i)
+  {
+    f();
+  } // end for i
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+  return elapsed.count() / n;
+} // end time_runs()
+
+int main(int argc, char **argv)
+{
+  const char *program = argv[0];
+
+  bool disassemble = false;
+  bool monomorphize = false;
+  std::size_t bench = 0;
+  for(; argc > 1; --argc, ++argv)
+  {
+    if(!std::strcmp(argv[1], "--disassemble"))
+    {
+      disassemble = true;
+    } // end if
+    else if(!std::strcmp(argv[1], "--monomorphize"))
+    {
+      monomorphize = true;
+    } // end else if
+    else if(!std::strcmp(argv[1], "--bench") && argc > 2 && std::atoi(argv[2]) > 0)
+    {
+      bench = std::atoi(argv[2]);
+      --argc;
+      ++argv;
+    } // end else if
+    else
+    {
+      std::cerr << "usage: " << program << " [--disassemble] [--monomorphize] [--bench n] < expression" << std::endl;
+      return 1;
+    } // end else
+  } // end for
+
+  std::string text((std::istreambuf_iterator<char>(std::cin)), std::istreambuf_iterator<char>());
+
+  try
+  {
+    auto tree = syntax::parse(text);
+
+    auto env = inference::prelude();
+    evaluation::compiler c(env);
+    evaluation::program bytecode;
+    if(monomorphize)
+    {
+      auto specialized = inference::monomorphize(tree, env);
+      std::cout << specialized.tree() << std::endl;
+      bytecode = c.compile(specialized);
+    } // end if
+    else
+    {
+      bytecode = c.compile(tree);
+    } // end else
+
+    if(disassemble)
+    {
+      evaluation::disassemble(std::cout, bytecode);
+    } // end if
+
+    evaluation::machine m(bytecode);
+    std::ostringstream result;
+    evaluation::print(result, m.run(), bytecode.m_type);
+
+    pretty_printer pp(std::cout);
+    pp << result.str() << " : " << bytecode.m_type << "\n";
+
+    if(bench)
+    {
+      evaluation::tree_walker w;
+      std::ostringstream walked;
+      evaluation::tree_walker::print(walked, w.evaluate(tree));
+      if(walked.str() != result.str())
+      {
+        std::cerr << "error: the tree walker evaluated " << walked.str() << std::endl;
+        return 1;
+      } // end if
+
+      double machine_time = time_runs(bench, [&]
+      {
+        m.run();
+        m.reset();
+      });
+
+      double walker_time = time_runs(bench, [&]
+      {
+        w.evaluate(tree);
+        w.reset();
+      });
+
+      std::cout << "bytecode:    " << machine_time << " ns per run" << std::endl;
+      std::cout << "tree walker: " << walker_time << " ns per run" << std::endl;
+      std::cout << "speedup:     " << walker_time / machine_time << std::endl;
+    } // end if
+  } // end try
+  catch(const unification::recursive_unification &e)
+  {
+    pretty_printer pp(std::cerr);
+    pp << "error: " << e.what() << ": " << e.x << " in " << e.y << "\n";
+    return 1;
+  } // end catch
+  catch(const unification::type_mismatch &e)
+  {
+    pretty_printer pp(std::cerr);
+    pp << "error: " << e.what() << ": " << e.x << " != " << e.y << "\n";
+    return 1;
+  } // end catch
+  catch(const std::runtime_error &e)
+  {
+    std::cerr << "error: " << e.what() << std::endl;
+    return 1;
+  } // end catch
+
+  return 0;
+}
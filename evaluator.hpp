@@ -0,0 +1,956 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <memory_resource>
+#include <stdexcept>
+#include <iostream>
+#include <boost/variant.hpp>
+#include "unification.hpp"
+#include "syntax.hpp"
+#include "inference.hpp"
+#include "monomorphize.hpp"
+
+namespace evaluation
+{
+
+// the evaluator runs type-checked programs by compiling them to bytecode for
+// a register machine
+//
+// because a program has been checked, a value needn't carry a tag saying
+// what it is. every value is one untagged word: an int or a bool is held
+// in it directly, and a closure, pair or record is a pointer to an object on
+// the machine's heap. the type of the program tells how to read the word
+// it evaluates to
+//
+// a saturated application of a builtin of the prelude compiles to a single
+// instruction, such as times, rather than a chain of closure calls, and
+// cond compiles to a branch so that only the arm chosen is evaluated. a
+// builtin used as a value is eta-expanded into an ordinary closure. a field
+// is selected by its offset when the record's type is closed where it is
+// selected, and by searching the record's labels otherwise
+//
+// each function has a frame of registers. register 0 holds its argument, and
+// the variables it captures are copied into registers of their own when it
+// is entered. a call in tail position reuses its caller's frame
+typedef std::uint64_t word;
+
+inline word from_int(const int x)
+{
+  return static_cast<word>(static_cast<std::int64_t>(x));
+} // end from_int()
+
+inline int to_int(const word x)
+{
+  return static_cast<int>(static_cast<std::int64_t>(x));
+} // end to_int()
+
+// the builtins of inference::prelude() the evaluator implements
+enum builtin_kind
+{
+  builtin_pair,
+  builtin_true,
+  builtin_cond,
+  builtin_zero,
+  builtin_pred,
+  builtin_times,
+  num_builtins
+}; // end builtin_kind
+
+inline const char *builtin_name(const builtin_kind b)
+{
+  static const char *names[] = {"pair", "true", "cond", "zero", "pred", "times"};
+  return names[b];
+} // end builtin_name()
+
+inline std::size_t builtin_arity(const builtin_kind b)
+{
+  static const std::size_t arities[] = {2, 0, 3, 1, 1, 2};
+  return arities[b];
+} // end builtin_arity()
+
+// returns num_builtins if name names no builtin
+inline builtin_kind find_builtin(const std::string &name)
+{
+  int b = 0;
+  for(; b < num_builtins && name != builtin_name(builtin_kind(b)); ++b)
+    ;
+
+  return builtin_kind(b);
+} // end find_builtin()
+
+// ints wrap around, as they would in a machine register
+inline int times(const int x, const int y)
+{
+  return static_cast<int>(static_cast<std::uint32_t>(x) * static_cast<std::uint32_t>(y));
+} // end times()
+
+inline int pred(const int x)
+{
+  return static_cast<int>(static_cast<std::uint32_t>(x) - 1u);
+} // end pred()
+
+enum opcode
+{
+  op_constant,       // r[a] = b
+  op_move,           // r[a] = r[b]
+  op_closure,        // r[a] = a closure of function b
+  op_fix,            // capture b of the closure r[a] = r[c]
+  op_call,           // r[a] = r[b](r[c])
+  op_tail_call,      // return r[b](r[c])
+  op_return,         // return r[a]
+  op_jump,           // continue at a
+  op_jump_if_false,  // if !r[a], continue at b
+  op_zero,           // r[a] = r[b] == 0
+  op_pred,           // r[a] = r[b] - 1
+  op_times,          // r[a] = r[b] * r[c]
+  op_pair,           // r[a] = (r[b], r[c])
+  op_record,         // r[a] = a record of kind constants[b] with fields r[c], r[c+1], ...
+  op_select,         // r[a] = field c of the record r[b]
+  op_select_label,   // r[a] = the field labelled constants[c] of the record r[b]
+  num_opcodes
+}; // end opcode
+
+inline const char *opcode_name(const opcode op)
+{
+  static const char *names[] =
+  {
+    "constant", "move", "closure", "fix", "call", "tail_call", "return", "jump", "jump_if_false",
+    "zero", "pred", "times", "pair", "record", "select", "select_label"
+  };
+  return names[op];
+} // end opcode_name()
+
+struct instruction
+{
+  opcode       m_op;
+  std::int32_t m_a, m_b, m_c;
+}; // end instruction
+
+struct function
+{
+  std::string               m_name;
+  std::vector<instruction>  m_code;
+  std::int32_t              m_num_registers;
+  // capture i is copied from register m_captured_from[i] of the enclosing
+  // function when a closure is made, and to register m_captured_to[i] when
+  // the closure is entered
+  std::vector<std::int32_t> m_captured_from;
+  std::vector<std::int32_t> m_captured_to;
+}; // end function
+
+struct program
+{
+  // m_functions[0] evaluates the whole program
+  std::vector<function>    m_functions;
+  // the kinds of records and the labels selected by op_select_label
+  std::vector<std::size_t> m_constants;
+  // the type of the program
+  unification::type        m_type;
+}; // end program
+
+// the objects of the machine's heap
+// the words of a closure's captures or a record's fields follow its header
+struct closure
+{
+  const function *m_function;
+
+  inline word *captures(void)
+  {
+    return reinterpret_cast<word*>(this + 1);
+  } // end captures()
+
+  inline const word *captures(void) const
+  {
+    return reinterpret_cast<const word*>(this + 1);
+  } // end captures()
+}; // end closure
+
+struct pair_object
+{
+  word m_first, m_second;
+}; // end pair_object
+
+struct record_object
+{
+  std::size_t m_kind;
+
+  inline word *fields(void)
+  {
+    return reinterpret_cast<word*>(this + 1);
+  } // end fields()
+
+  inline const word *fields(void) const
+  {
+    return reinterpret_cast<const word*>(this + 1);
+  } // end fields()
+}; // end record_object
+
+// returns the offset of l among labels, or labels.size() if it is absent
+inline std::size_t find_label(const std::vector<unification::label> &labels, const unification::label l)
+{
+  auto iter = std::lower_bound(labels.begin(), labels.end(), l);
+  return (iter != labels.end() && *iter == l) ? iter - labels.begin() : labels.size();
+} // end find_label()
+
+// compiles a program against an environment, which should be
+// inference::prelude() or a part of it, since only its builtins have
+// implementations
+class compiler
+{
+  public:
+    inline compiler(const inference::environment &env)
+      : m_environment(env),
+        m_table(0),
+        m_frame(0)
+    {}
+
+    // throws as inference::infer_type() does if n is ill-typed, and
+    // std::runtime_error if n uses a name without an implementation
+    inline program compile(const syntax::node &n)
+    {
+      inference::type_table table;
+      auto t = inference::infer_type(n, m_environment, table);
+      return compile_program(n, t, table);
+    } // end compile()
+
+    // as above, but for a program whose generalized bindings have been
+    // specialized, in whose copies more records have closed types
+    inline program compile(const inference::specialized_program &p)
+    {
+      return compile_program(p.tree(), *p.types().find(p.tree()), p.types());
+    } // end compile()
+
+  private:
+    inline program compile_program(const syntax::node &n, const unification::type &t, const inference::type_table &table)
+    {
+      m_program = program();
+      m_program.m_type = t;
+      m_table = &table;
+
+      m_program.m_functions.push_back(function());
+      m_program.m_functions[0].m_name = "main";
+      m_program.m_functions[0].m_num_registers = 1;
+
+      frame main(0, 0);
+      m_frame = &main;
+      compile(n, allocate(), true);
+
+      return std::move(m_program);
+    } // end compile_program()
+
+    // the state of a function being compiled
+    struct frame
+    {
+      inline frame(const std::size_t f, frame *parent)
+        : m_function(f),
+          m_parent(parent)
+      {}
+
+      std::size_t                                      m_function;
+      frame                                           *m_parent;
+      std::vector<std::pair<std::string,std::int32_t>> m_locals;
+      std::map<std::string,std::int32_t>               m_captures;
+    }; // end frame
+
+    // dispatches a node to the compiler's rule for it
+    struct dispatcher
+      : boost::static_visitor<>
+    {
+      inline dispatcher(compiler &c, const std::int32_t dest, const bool tail)
+        : m_compiler(c),
+          m_dest(dest),
+          m_tail(tail)
+      {}
+
+      template<typename T>
+        inline void operator()(const T &x) const
+      {
+        m_compiler.compile(x, m_dest, m_tail);
+      } // end operator()()
+
+      compiler     &m_compiler;
+      std::int32_t  m_dest;
+      bool          m_tail;
+    }; // end dispatcher
+
+    inline function &current(void)
+    {
+      return m_program.m_functions[m_frame->m_function];
+    } // end current()
+
+    inline std::int32_t allocate(void)
+    {
+      return current().m_num_registers++;
+    } // end allocate()
+
+    inline std::size_t emit(const opcode op, const std::int32_t a = 0, const std::int32_t b = 0, const std::int32_t c = 0)
+    {
+      current().m_code.push_back(instruction{op, a, b, c});
+      return current().m_code.size() - 1;
+    } // end emit()
+
+    inline std::int32_t constant(const std::size_t x)
+    {
+      auto iter = std::find(m_program.m_constants.begin(), m_program.m_constants.end(), x);
+      if(iter == m_program.m_constants.end())
+      {
+        m_program.m_constants.push_back(x);
+        iter = m_program.m_constants.end() - 1;
+      } // end if
+
+      return iter - m_program.m_constants.begin();
+    } // end constant()
+
+    // returns true if name is bound in f or in a function enclosing it
+    inline static bool bound(const frame *f, const std::string &name)
+    {
+      for(; f; f = f->m_parent)
+      {
+        for(auto i = f->m_locals.begin(); i != f->m_locals.end(); ++i)
+        {
+          if(i->first == name) return true;
+        } // end for i
+      } // end for f
+
+      return false;
+    } // end bound()
+
+    // finds the register of f holding the variable name, capturing it from
+    // the enclosing function if it is bound there
+    inline bool lookup(frame &f, const std::string &name, std::int32_t &result)
+    {
+      for(auto i = f.m_locals.rbegin(); i != f.m_locals.rend(); ++i)
+      {
+        if(i->first == name)
+        {
+          result = i->second;
+          return true;
+        } // end if
+      } // end for i
+
+      auto iter = f.m_captures.find(name);
+      if(iter != f.m_captures.end())
+      {
+        result = iter->second;
+        return true;
+      } // end if
+
+      std::int32_t outer = 0;
+      if(!f.m_parent || !lookup(*f.m_parent, name, outer))
+      {
+        return false;
+      } // end if
+
+      auto &fn = m_program.m_functions[f.m_function];
+      result = fn.m_num_registers++;
+      fn.m_captured_from.push_back(outer);
+      fn.m_captured_to.push_back(result);
+      f.m_captures[name] = result;
+      return true;
+    } // end lookup()
+
+    inline void compile(const syntax::node &n, const std::int32_t dest, const bool tail)
+    {
+      boost::apply_visitor(dispatcher(*this, dest, tail), n);
+    } // end compile()
+
+    // returns a register holding the value of n
+    inline std::int32_t value(const syntax::node &n)
+    {
+      std::int32_t result = 0;
+      auto id = boost::get<syntax::identifier>(&n);
+      if(id && lookup(*m_frame, id->name(), result))
+      {
+        return result;
+      } // end if
+
+      result = allocate();
+      compile(n, result, false);
+      return result;
+    } // end value()
+
+    // the code of a node in tail position returns its value
+    inline void finish(const std::int32_t dest, const bool tail)
+    {
+      if(tail)
+      {
+        emit(op_return, dest);
+      } // end if
+    } // end finish()
+
+    inline void compile(const syntax::integer_literal &il, const std::int32_t dest, const bool tail)
+    {
+      emit(op_constant, dest, il.value());
+      finish(dest, tail);
+    } // end compile()
+
+    inline void compile(const syntax::identifier &id, const std::int32_t dest, const bool tail)
+    {
+      std::int32_t source = 0;
+      if(lookup(*m_frame, id.name(), source))
+      {
+        emit(op_move, dest, source);
+      } // end if
+      else
+      {
+        auto b = find_builtin(id.name());
+        if(b == num_builtins)
+        {
+          throw std::runtime_error("evaluation: no implementation of " + id.name());
+        } // end if
+
+        if(builtin_arity(b) == 0)
+        {
+          emit(op_constant, dest, 1);
+        } // end if
+        else
+        {
+          // fn #0 => fn #1 => ... => b #0 #1 ...
+          // the parser never makes these names, so they shadow nothing
+          syntax::node body = id;
+          for(std::size_t i = 0; i < builtin_arity(b); ++i)
+          {
+            body = syntax::apply(body, syntax::identifier("#" + std::to_string(i)));
+          } // end for i
+
+          for(std::size_t i = builtin_arity(b); i > 0; --i)
+          {
+            body = syntax::lambda("#" + std::to_string(i - 1), body);
+          } // end for i
+
+          compile(body, dest, false);
+        } // end else
+      } // end else
+
+      finish(dest, tail);
+    } // end compile()
+
+    inline void compile(const syntax::apply &app, const std::int32_t dest, const bool tail)
+    {
+      // unwind the spine f a1 a2 ... an
+      std::vector<const syntax::node*> arguments;
+      const syntax::node *head = &app.argument();
+      arguments.push_back(head);
+      for(head = &app.function(); auto inner = boost::get<syntax::apply>(head); head = &inner->function())
+      {
+        arguments.push_back(&inner->argument());
+      } // end for
+      std::reverse(arguments.begin(), arguments.end());
+
+      std::int32_t callee = 0;
+      std::size_t applied = 0;
+
+      auto id = boost::get<syntax::identifier>(head);
+      auto b = (id && !bound(m_frame, id->name())) ? find_builtin(id->name()) : num_builtins;
+      if(b != num_builtins && builtin_arity(b) > 0 && builtin_arity(b) <= arguments.size())
+      {
+        applied = builtin_arity(b);
+        bool saturated = (applied == arguments.size());
+        callee = saturated ? dest : allocate();
+
+        if(b == builtin_cond)
+        {
+          compile_cond(*arguments[0], *arguments[1], *arguments[2], callee, tail && saturated);
+          if(saturated) return;
+        } // end if
+        else
+        {
+          std::int32_t x = value(*arguments[0]);
+          std::int32_t y = applied > 1 ? value(*arguments[1]) : 0;
+
+          switch(b)
+          {
+            case builtin_pair:  emit(op_pair,  callee, x, y); break;
+            case builtin_zero:  emit(op_zero,  callee, x);    break;
+            case builtin_pred:  emit(op_pred,  callee, x);    break;
+            case builtin_times: emit(op_times, callee, x, y); break;
+            default: break;
+          } // end switch
+
+          if(saturated)
+          {
+            finish(dest, tail);
+            return;
+          } // end if
+        } // end else
+      } // end if
+      else
+      {
+        callee = value(*head);
+      } // end else
+
+      // apply whatever remains through closures
+      for(; applied < arguments.size(); ++applied)
+      {
+        std::int32_t argument = value(*arguments[applied]);
+        bool last = (applied + 1 == arguments.size());
+
+        if(last && tail)
+        {
+          emit(op_tail_call, 0, callee, argument);
+        } // end if
+        else
+        {
+          std::int32_t result = last ? dest : allocate();
+          emit(op_call, result, callee, argument);
+          callee = result;
+        } // end else
+      } // end for
+    } // end compile()
+
+    inline void compile_cond(const syntax::node &test, const syntax::node &then, const syntax::node &otherwise, const std::int32_t dest, const bool tail)
+    {
+      std::int32_t t = value(test);
+      auto branch = emit(op_jump_if_false, t);
+
+      compile(then, dest, tail);
+      auto jump = tail ? 0 : emit(op_jump);
+
+      current().m_code[branch].m_b = current().m_code.size();
+      compile(otherwise, dest, tail);
+
+      if(!tail)
+      {
+        current().m_code[jump].m_a = current().m_code.size();
+      } // end if
+    } // end compile_cond()
+
+    // returns the index of the function
+    inline std::size_t compile_function(const syntax::lambda &l, const std::string &name)
+    {
+      std::size_t result = m_program.m_functions.size();
+      m_program.m_functions.push_back(function());
+      m_program.m_functions[result].m_name = name;
+      m_program.m_functions[result].m_num_registers = 1;
+
+      frame f(result, m_frame);
+      f.m_locals.push_back(std::make_pair(l.parameter(), 0));
+
+      frame *saved = m_frame;
+      m_frame = &f;
+      compile(l.body(), allocate(), true);
+      m_frame = saved;
+
+      return result;
+    } // end compile_function()
+
+    inline void compile(const syntax::lambda &l, const std::int32_t dest, const bool tail)
+    {
+      emit(op_closure, dest, compile_function(l, "fn " + l.parameter()));
+      finish(dest, tail);
+    } // end compile()
+
+    inline void compile(const syntax::let &l, const std::int32_t dest, const bool tail)
+    {
+      std::int32_t v = value(l.definition());
+
+      m_frame->m_locals.push_back(std::make_pair(l.name(), v));
+      compile(l.body(), dest, tail);
+      m_frame->m_locals.pop_back();
+    } // end compile()
+
+    typedef std::vector<std::pair<std::string, const syntax::node*>> recursive_bindings;
+
+    inline void compile_recursive(const recursive_bindings &bindings)
+    {
+      std::vector<std::int32_t> registers;
+      for(auto i = bindings.begin(); i != bindings.end(); ++i)
+      {
+        registers.push_back(allocate());
+        m_frame->m_locals.push_back(std::make_pair(i->first, registers.back()));
+      } // end for i
+
+      std::vector<std::size_t> functions;
+      for(auto i = bindings.begin(); i != bindings.end(); ++i)
+      {
+        auto l = boost::get<syntax::lambda>(i->second);
+        if(!l)
+        {
+          throw std::runtime_error("evaluation: letrec can only define functions, but " + i->first + " isn't one");
+        } // end if
+
+        functions.push_back(compile_function(*l, i->first));
+        emit(op_closure, registers[functions.size() - 1], functions.back());
+      } // end for i
+
+      // the closures were made before the ones they capture, so tie the knots
+      for(std::size_t i = 0; i < functions.size(); ++i)
+      {
+        auto &from = m_program.m_functions[functions[i]].m_captured_from;
+        for(std::size_t c = 0; c < from.size(); ++c)
+        {
+          if(std::find(registers.begin(), registers.end(), from[c]) != registers.end())
+          {
+            emit(op_fix, registers[i], c, from[c]);
+          } // end if
+        } // end for c
+      } // end for i
+    } // end compile_recursive()
+
+    inline void compile(const syntax::letrec &l, const std::int32_t dest, const bool tail)
+    {
+      compile_recursive(recursive_bindings(1, std::make_pair(l.name(), &l.definition())));
+      compile(l.body(), dest, tail);
+      m_frame->m_locals.pop_back();
+    } // end compile()
+
+    inline void compile(const syntax::letrec_group &l, const std::int32_t dest, const bool tail)
+    {
+      recursive_bindings bindings;
+      for(auto i = l.bindings().begin(); i != l.bindings().end(); ++i)
+      {
+        bindings.push_back(std::make_pair(i->first, &i->second));
+      } // end for i
+
+      compile_recursive(bindings);
+      compile(l.body(), dest, tail);
+      m_frame->m_locals.resize(m_frame->m_locals.size() - l.bindings().size());
+    } // end compile()
+
+    inline void compile(const syntax::record &r, const std::int32_t dest, const bool tail)
+    {
+      auto &fields = r.fields();
+
+      std::vector<unification::label> labels;
+      for(auto i = fields.begin(); i != fields.end(); ++i)
+      {
+        labels.push_back(unification::rows().intern(i->first));
+      } // end for i
+
+      std::vector<unification::label> sorted = labels;
+      std::sort(sorted.begin(), sorted.end());
+
+      // the fields go to consecutive registers in the order of their labels
+      std::int32_t first = current().m_num_registers;
+      current().m_num_registers += fields.size();
+
+      for(std::size_t i = 0; i < fields.size(); ++i)
+      {
+        compile(fields[i].second, first + find_label(sorted, labels[i]), false);
+      } // end for i
+
+      emit(op_record, dest, constant(unification::rows().kind(sorted)), first);
+      finish(dest, tail);
+    } // end compile()
+
+    inline void compile(const syntax::selection &s, const std::int32_t dest, const bool tail)
+    {
+      std::int32_t record = value(s.record());
+      auto label = unification::rows().intern(s.label());
+
+      // a closed record type fixes the offset of every field
+      auto t = m_table->find(s.record());
+      auto op = t ? boost::get<unification::type_operator>(t) : 0;
+      if(op && unification::is_record(*op) && op->size() > 0)
+      {
+        auto row = boost::get<unification::type_operator>(&(*op)[op->size() - 1]);
+        if(row && row->kind() == unification::row_registry::empty())
+        {
+          emit(op_select, dest, record, find_label(unification::rows().labels(op->kind()), label));
+          finish(dest, tail);
+          return;
+        } // end if
+      } // end if
+
+      emit(op_select_label, dest, record, constant(label));
+      finish(dest, tail);
+    } // end compile()
+
+    const inference::environment &m_environment;
+    const inference::type_table  *m_table;
+    program                       m_program;
+    frame                        *m_frame;
+}; // end compiler
+
+// runs a program
+// the objects it makes live until reset()
+class machine
+{
+  public:
+    inline machine(const program &p, const std::size_t stack_size = std::size_t(1) << 20)
+      : m_program(p),
+        m_stack(stack_size),
+        m_top(0)
+    {}
+
+    // returns the value of the program
+    // throws std::runtime_error if the registers run out
+    inline word run(void)
+    {
+      m_top = 0;
+      return execute(&m_program.m_functions[0], 0, 0);
+    } // end run()
+
+    // frees every object made by previous runs
+    inline void reset(void)
+    {
+      m_heap.release();
+    } // end reset()
+
+  private:
+    inline void *allocate(const std::size_t header, const std::size_t words)
+    {
+      return m_heap.allocate(header + words * sizeof(word), alignof(word));
+    } // end allocate()
+
+    // a call which isn't in tail position pushes a frame, so that the depth
+    // of recursion is limited by the registers rather than by the native stack
+    inline word execute(const function *f, const closure *c, word argument)
+    {
+      m_frames.clear();
+      std::size_t base = m_top;
+      std::size_t pc = 0;
+      word *r = 0;
+      const instruction *code = 0;
+
+      enter:
+      if(base + f->m_num_registers > m_stack.size())
+      {
+        throw std::runtime_error("evaluation: stack overflow");
+      } // end if
+      m_top = base + f->m_num_registers;
+
+      r = m_stack.data() + base;
+      r[0] = argument;
+      for(std::size_t i = 0; i < f->m_captured_to.size(); ++i)
+      {
+        r[f->m_captured_to[i]] = c->captures()[i];
+      } // end for i
+
+      code = f->m_code.data();
+      for(pc = 0; ; )
+      {
+        const instruction &i = code[pc++];
+
+        switch(i.m_op)
+        {
+          case op_constant:
+            r[i.m_a] = from_int(i.m_b);
+            break;
+
+          case op_move:
+            r[i.m_a] = r[i.m_b];
+            break;
+
+          case op_closure:
+          {
+            auto &callee = m_program.m_functions[i.m_b];
+            auto result = new(allocate(sizeof(closure), callee.m_captured_from.size())) closure{&callee};
+            for(std::size_t k = 0; k < callee.m_captured_from.size(); ++k)
+            {
+              result->captures()[k] = r[callee.m_captured_from[k]];
+            } // end for k
+
+            r[i.m_a] = reinterpret_cast<word>(result);
+            break;
+          } // end case
+
+          case op_fix:
+            reinterpret_cast<closure*>(r[i.m_a])->captures()[i.m_b] = r[i.m_c];
+            break;
+
+          case op_call:
+            m_frames.push_back(frame{f, base, pc, std::size_t(i.m_a)});
+            c = reinterpret_cast<const closure*>(r[i.m_b]);
+            argument = r[i.m_c];
+            f = c->m_function;
+            base = m_top;
+            goto enter;
+
+          case op_tail_call:
+            c = reinterpret_cast<const closure*>(r[i.m_b]);
+            argument = r[i.m_c];
+            f = c->m_function;
+            goto enter;
+
+          case op_return:
+          {
+            word result = r[i.m_a];
+            m_top = base;
+            if(m_frames.empty())
+            {
+              return result;
+            } // end if
+
+            auto &caller = m_frames.back();
+            f = caller.m_function;
+            base = caller.m_base;
+            pc = caller.m_pc;
+            code = f->m_code.data();
+            r = m_stack.data() + base;
+            r[caller.m_result] = result;
+            m_frames.pop_back();
+            break;
+          } // end case
+
+          case op_jump:
+            pc = i.m_a;
+            break;
+
+          case op_jump_if_false:
+            if(!r[i.m_a]) pc = i.m_b;
+            break;
+
+          case op_zero:
+            r[i.m_a] = (to_int(r[i.m_b]) == 0);
+            break;
+
+          case op_pred:
+            r[i.m_a] = from_int(pred(to_int(r[i.m_b])));
+            break;
+
+          case op_times:
+            r[i.m_a] = from_int(times(to_int(r[i.m_b]), to_int(r[i.m_c])));
+            break;
+
+          case op_pair:
+            r[i.m_a] = reinterpret_cast<word>(new(allocate(sizeof(pair_object), 0)) pair_object{r[i.m_b], r[i.m_c]});
+            break;
+
+          case op_record:
+          {
+            auto kind = m_program.m_constants[i.m_b];
+            auto n = unification::rows().labels(kind).size();
+            auto result = new(allocate(sizeof(record_object), n)) record_object{kind};
+            std::copy(r + i.m_c, r + i.m_c + n, result->fields());
+            r[i.m_a] = reinterpret_cast<word>(result);
+            break;
+          } // end case
+
+          case op_select:
+            r[i.m_a] = reinterpret_cast<const record_object*>(r[i.m_b])->fields()[i.m_c];
+            break;
+
+          case op_select_label:
+          {
+            auto record = reinterpret_cast<const record_object*>(r[i.m_b]);
+            auto &labels = unification::rows().labels(record->m_kind);
+            r[i.m_a] = record->fields()[find_label(labels, m_program.m_constants[i.m_c])];
+            break;
+          } // end case
+
+          default:
+            throw std::logic_error("evaluation: bad opcode");
+        } // end switch
+      } // end for pc
+    } // end execute()
+
+    // where to resume a caller when its callee returns
+    struct frame
+    {
+      const function *m_function;
+      std::size_t     m_base;
+      std::size_t     m_pc;
+      std::size_t     m_result;
+    }; // end frame
+
+    const program                       &m_program;
+    std::vector<word>                    m_stack;
+    std::size_t                          m_top;
+    std::vector<frame>                   m_frames;
+    std::pmr::monotonic_buffer_resource  m_heap;
+}; // end machine
+
+// prints x as a value of type t
+inline void print(std::ostream &os, const word x, const unification::type &t)
+{
+  using namespace unification;
+
+  auto op = boost::get<type_operator>(&t);
+  if(!op)
+  {
+    // a value of a type variable can't be inspected
+    os << "_";
+  } // end if
+  else if(op->kind() == inference::types::integer)
+  {
+    os << to_int(x);
+  } // end else if
+  else if(op->kind() == inference::types::boolean)
+  {
+    os << (x ? "true" : "false");
+  } // end else if
+  else if(op->kind() == inference::types::function)
+  {
+    os << "<function>";
+  } // end else if
+  else if(op->kind() == inference::types::pair)
+  {
+    auto p = reinterpret_cast<const pair_object*>(x);
+    os << "(";
+    print(os, p->m_first, (*op)[0]);
+    os << ", ";
+    print(os, p->m_second, (*op)[1]);
+    os << ")";
+  } // end else if
+  else if(is_record(*op))
+  {
+    // the record may have fields its type doesn't mention
+    auto r = reinterpret_cast<const record_object*>(x);
+    auto &labels = rows().labels(r->m_kind);
+    auto &typed = rows().labels(op->kind());
+
+    // fields are stored in order of their interned labels, which depends on
+    // the order labels were first seen, so they are printed in order of
+    // their names, as the tree walker prints them
+    std::vector<std::size_t> order(labels.size());
+    for(std::size_t i = 0; i < order.size(); ++i)
+    {
+      order[i] = i;
+    } // end for i
+    std::sort(order.begin(), order.end(), [&](std::size_t x, std::size_t y)
+    {
+      return rows().name(labels[x]) < rows().name(labels[y]);
+    });
+
+    os << "{";
+    for(std::size_t k = 0; k < order.size(); ++k)
+    {
+      auto i = order[k];
+      os << (k ? ", " : "") << rows().name(labels[i]) << " = ";
+
+      auto j = find_label(typed, labels[i]);
+      if(j < typed.size())
+      {
+        print(os, r->fields()[i], (*op)[j]);
+      } // end if
+      else
+      {
+        os << "_";
+      } // end else
+    } // end for i
+    os << "}";
+  } // end else if
+  else
+  {
+    os << "<" << inference::constructors().name(op->kind()) << ">";
+  } // end else
+} // end print()
+
+inline void disassemble(std::ostream &os, const program &p)
+{
+  for(std::size_t f = 0; f < p.m_functions.size(); ++f)
+  {
+    auto &fn = p.m_functions[f];
+    os << "function " << f << " (" << fn.m_name << "), " << fn.m_num_registers << " registers";
+
+    for(std::size_t c = 0; c < fn.m_captured_to.size(); ++c)
+    {
+      os << (c ? ", " : ", captures ") << "r" << fn.m_captured_to[c] << " <- r" << fn.m_captured_from[c];
+    } // end for c
+    os << std::endl;
+
+    for(std::size_t pc = 0; pc < fn.m_code.size(); ++pc)
+    {
+      auto &i = fn.m_code[pc];
+      os << "  " << pc << ": " << opcode_name(i.m_op) << " " << i.m_a << " " << i.m_b << " " << i.m_c << std::endl;
+    } // end for pc
+  } // end for f
+} // end disassemble()
+
+} // end evaluation
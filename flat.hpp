@@ -0,0 +1,836 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <boost/variant.hpp>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "syntax.hpp"
+#include "dependencies.hpp"
+
+namespace syntax
+{
+
+// a flat_tree is a syntax tree encoded in one contiguous buffer, which may be
+// handed between processes or memory-mapped from a file and traversed in
+// place without building syntax::node objects
+//
+// the buffer is the magic string "hmast001" followed by native 32-bit words:
+//
+//   num_strings num_cells root
+//   string_end*     -- num_strings offsets into the string bytes
+//   cell*           -- num_cells cells holding the nodes
+//   byte*           -- the bytes of the interned strings
+//
+// each node is a run of cells beginning with its tag, which is the index of
+// its type in syntax::node. names refer to the string table and children
+// refer to the index of their first cell, which always precedes their
+// parent's, so a tree is acyclic by construction:
+//
+//   integer_literal  0 value
+//   identifier       1 name
+//   apply            2 function argument
+//   lambda           3 parameter body
+//   let              4 name definition body
+//   letrec           5 name definition body
+//   letrec_group     6 n (name definition)*n body m (size member*)*m
+//   record           7 n (label value)*n
+//   selection        8 record label
+//
+// a letrec_group carries its strongly connected components, in the order of
+// analyze_dependencies(), so that a reader needn't repeat the analysis
+struct bad_flat_tree
+  : std::runtime_error
+{
+  inline bad_flat_tree(const std::string &what)
+    : std::runtime_error("bad flat tree: " + what)
+  {}
+};
+
+class flat_tree;
+class flat_bindings;
+
+// a reference to one node of a flat_tree
+//
+// the accessors mirror those of the classes of syntax::node, so that the
+// inferencer's rules may be applied to either
+class flat_node
+{
+  public:
+    typedef std::uint32_t cell;
+
+    enum kind_type
+    {
+      integer_literal_kind,
+      identifier_kind,
+      apply_kind,
+      lambda_kind,
+      let_kind,
+      letrec_kind,
+      letrec_group_kind,
+      record_kind,
+      selection_kind
+    }; // end kind_type
+
+    inline flat_node(const flat_tree &tree, const cell index)
+      : m_tree(&tree),
+        m_index(index)
+    {}
+
+    inline kind_type kind() const
+    {
+      return static_cast<kind_type>(at(0));
+    }
+
+    // identifies the node for as long as its tree is alive
+    inline const void *address() const
+    {
+      return &at(0);
+    }
+
+    // integer_literal
+    inline int value() const
+    {
+      return static_cast<int>(at(1));
+    }
+
+    // identifier, let and letrec
+    inline std::string name() const;
+
+    // apply
+    inline flat_node function() const
+    {
+      return child(1);
+    }
+
+    inline flat_node argument() const
+    {
+      return child(2);
+    }
+
+    // lambda
+    inline std::string parameter() const
+    {
+      return name();
+    }
+
+    // lambda, let, letrec and letrec_group
+    inline flat_node body() const
+    {
+      if(kind() == letrec_group_kind)
+      {
+        return child(2 + 2 * at(1));
+      }
+
+      return child(kind() == lambda_kind ? 2 : 3);
+    }
+
+    // let and letrec
+    inline flat_node definition() const
+    {
+      return child(2);
+    }
+
+    // letrec_group
+    inline flat_bindings bindings() const;
+
+    // record
+    inline flat_bindings fields() const;
+
+    // selection
+    inline flat_node record() const
+    {
+      return child(1);
+    }
+
+    inline std::string label() const;
+
+    // the strongly connected components of a letrec_group's bindings
+    inline std::vector<std::vector<std::size_t>> components() const
+    {
+      std::vector<std::vector<std::size_t>> result(at(3 + 2 * at(1)));
+
+      cell c = 4 + 2 * at(1);
+      for(auto i = result.begin(); i != result.end(); ++i)
+      {
+        i->resize(at(c++));
+        for(auto j = i->begin(); j != i->end(); ++j)
+        {
+          *j = at(c++);
+        } // end for j
+      } // end for i
+
+      return result;
+    }
+
+  private:
+    friend class flat_bindings;
+
+    inline const cell &at(const cell i) const;
+
+    inline flat_node child(const cell i) const
+    {
+      return flat_node(*m_tree, at(i));
+    }
+
+    const flat_tree *m_tree;
+    cell             m_index;
+};
+
+// the bindings of a letrec_group, indexed like a std::vector<letrec_group::binding>,
+// or the fields of a record, whose layout is the same
+class flat_bindings
+{
+  public:
+    typedef std::pair<std::string, flat_node> binding;
+
+    inline flat_bindings(const flat_node &group)
+      : m_group(group)
+    {}
+
+    inline std::size_t size() const
+    {
+      return m_group.at(1);
+    }
+
+    inline binding operator[](const std::size_t i) const;
+
+  private:
+    flat_node m_group;
+};
+
+inline flat_bindings flat_node::bindings() const
+{
+  return flat_bindings(*this);
+}
+
+inline flat_bindings flat_node::fields() const
+{
+  return flat_bindings(*this);
+}
+
+// a view of an encoded tree, which must outlive the view
+class flat_tree
+{
+  public:
+    typedef flat_node::cell cell;
+
+    // checks that the size bytes at data hold a well-formed tree
+    // data must be aligned to 4 bytes
+    inline flat_tree(const void *data, const std::size_t size)
+    {
+      auto bytes = static_cast<const char*>(data);
+
+      if(size < 8 + 3 * sizeof(cell) || std::memcmp(bytes, "hmast001", 8))
+      {
+        throw bad_flat_tree("missing magic");
+      } // end if
+
+      auto header = reinterpret_cast<const cell*>(bytes + 8);
+      m_num_strings = header[0];
+      m_num_cells   = header[1];
+      m_root        = header[2];
+
+      std::size_t words = 3 + std::size_t(m_num_strings) + m_num_cells;
+      if((size - 8) / sizeof(cell) < words)
+      {
+        throw bad_flat_tree("truncated");
+      } // end if
+
+      m_string_ends = header + 3;
+      m_cells       = m_string_ends + m_num_strings;
+      m_strings     = bytes + 8 + words * sizeof(cell);
+
+      std::size_t num_bytes = size - 8 - words * sizeof(cell);
+      for(cell i = 0; i < m_num_strings; ++i)
+      {
+        if(m_string_ends[i] > num_bytes || (i > 0 && m_string_ends[i] < m_string_ends[i-1]))
+        {
+          throw bad_flat_tree("bad string table");
+        } // end if
+      } // end for i
+
+      verify();
+    } // end flat_tree()
+
+    inline flat_node root() const
+    {
+      return flat_node(*this, m_root);
+    } // end root()
+
+    inline std::string string(const cell i) const
+    {
+      cell begin = i ? m_string_ends[i-1] : 0;
+      return std::string(m_strings + begin, m_strings + m_string_ends[i]);
+    } // end string()
+
+    inline const cell &operator[](const cell i) const
+    {
+      return m_cells[i];
+    } // end operator[]()
+
+  private:
+    // checks every node, so that traversal needn't
+    inline void verify() const
+    {
+      // children must refer to the beginning of an earlier node
+      std::vector<bool> starts(m_num_cells, false);
+
+      for(cell i = 0, n = 0; i < m_num_cells; i += n)
+      {
+        n = size(i);
+
+        switch(m_cells[i])
+        {
+          case flat_node::integer_literal_kind:
+            break;
+
+          case flat_node::identifier_kind:
+            check_string(i + 1);
+            break;
+
+          case flat_node::apply_kind:
+            check_child(starts, i + 1);
+            check_child(starts, i + 2);
+            break;
+
+          case flat_node::lambda_kind:
+            check_string(i + 1);
+            check_child(starts, i + 2);
+            break;
+
+          case flat_node::let_kind:
+          case flat_node::letrec_kind:
+            check_string(i + 1);
+            check_child(starts, i + 2);
+            check_child(starts, i + 3);
+            break;
+
+          case flat_node::letrec_group_kind:
+          {
+            cell bindings = m_cells[i + 1];
+            for(cell b = 0; b < bindings; ++b)
+            {
+              check_string(i + 2 + 2 * b);
+              check_child(starts, i + 3 + 2 * b);
+            } // end for b
+            check_child(starts, i + 2 + 2 * bindings);
+
+            // every binding must belong to exactly one component
+            std::vector<bool> seen(bindings, false);
+            cell c = i + 4 + 2 * bindings;
+            for(cell k = 0; k < m_cells[i + 3 + 2 * bindings]; ++k)
+            {
+              cell members = m_cells[c++];
+              for(cell m = 0; m < members; ++m, ++c)
+              {
+                if(m_cells[c] >= bindings || seen[m_cells[c]])
+                {
+                  throw bad_flat_tree("bad letrec_group components");
+                } // end if
+                seen[m_cells[c]] = true;
+              } // end for m
+            } // end for k
+
+            if(std::find(seen.begin(), seen.end(), false) != seen.end())
+            {
+              throw bad_flat_tree("bad letrec_group components");
+            } // end if
+
+            check_component_order(i);
+            break;
+          } // end case
+
+          case flat_node::record_kind:
+            for(cell f = 0; f < m_cells[i + 1]; ++f)
+            {
+              check_string(i + 2 + 2 * f);
+              check_child(starts, i + 3 + 2 * f);
+            } // end for f
+            break;
+
+          case flat_node::selection_kind:
+            check_child(starts, i + 1);
+            check_string(i + 2);
+            break;
+        } // end switch
+
+        starts[i] = true;
+      } // end for i
+
+      if(m_root >= m_num_cells || !starts[m_root])
+      {
+        throw bad_flat_tree("bad root");
+      } // end if
+    } // end verify()
+
+    // every binding of the letrec_group at i may depend only on bindings in
+    // its own or an earlier component, as analyze_dependencies() orders them
+    //
+    // components merged more coarsely than necessary aren't detected: they
+    // make inference less general, but not unsound
+    inline void check_component_order(const cell i) const
+    {
+      cell bindings = m_cells[i + 1];
+
+      std::map<std::string, cell> component_of;
+      cell c = i + 4 + 2 * bindings;
+      for(cell k = 0; k < m_cells[i + 3 + 2 * bindings]; ++k)
+      {
+        cell members = m_cells[c++];
+        for(cell m = 0; m < members; ++m, ++c)
+        {
+          if(!component_of.insert(std::make_pair(string(m_cells[i + 2 + 2 * m_cells[c]]), k)).second)
+          {
+            throw bad_flat_tree("letrec_group binds a name more than once");
+          } // end if
+        } // end for m
+      } // end for k
+
+      for(cell b = 0; b < bindings; ++b)
+      {
+        cell component = component_of[string(m_cells[i + 2 + 2 * b])];
+
+        auto free = free_identifiers(m_cells[i + 3 + 2 * b]);
+        for(auto name = free.begin();
+            name != free.end();
+            ++name)
+        {
+          auto dependency = component_of.find(*name);
+          if(dependency != component_of.end() && dependency->second > component)
+          {
+            throw bad_flat_tree("letrec_group components out of dependency order");
+          } // end if
+        } // end for name
+      } // end for b
+    } // end check_component_order()
+
+    // returns the identifiers which occur free in the node beginning at root,
+    // like syntax::free_identifiers(), with an explicit stack so that a deep
+    // tree doesn't exhaust the call stack
+    inline std::set<std::string> free_identifiers(const cell root) const
+    {
+      enum action {visit, bind, unbind};
+
+      std::set<std::string>                    result;
+      std::multiset<std::string>               bound;
+      std::vector<std::pair<action, cell>>     stack(1, std::make_pair(visit, root));
+
+      while(!stack.empty())
+      {
+        auto top = stack.back();
+        stack.pop_back();
+
+        // a bind or unbind's cell holds the name's string
+        if(top.first == bind)
+        {
+          bound.insert(string(m_cells[top.second]));
+          continue;
+        } // end if
+        else if(top.first == unbind)
+        {
+          bound.erase(bound.find(string(m_cells[top.second])));
+          continue;
+        } // end else if
+
+        cell i = top.second;
+        switch(m_cells[i])
+        {
+          case flat_node::identifier_kind:
+          {
+            auto name = string(m_cells[i + 1]);
+            if(!bound.count(name))
+            {
+              result.insert(name);
+            } // end if
+            break;
+          } // end case
+
+          case flat_node::apply_kind:
+            stack.push_back(std::make_pair(visit, m_cells[i + 1]));
+            stack.push_back(std::make_pair(visit, m_cells[i + 2]));
+            break;
+
+          case flat_node::lambda_kind:
+            stack.push_back(std::make_pair(unbind, i + 1));
+            stack.push_back(std::make_pair(visit, m_cells[i + 2]));
+            stack.push_back(std::make_pair(bind, i + 1));
+            break;
+
+          case flat_node::let_kind:
+            // the name isn't bound in its own definition
+            stack.push_back(std::make_pair(unbind, i + 1));
+            stack.push_back(std::make_pair(visit, m_cells[i + 3]));
+            stack.push_back(std::make_pair(bind, i + 1));
+            stack.push_back(std::make_pair(visit, m_cells[i + 2]));
+            break;
+
+          case flat_node::letrec_kind:
+            stack.push_back(std::make_pair(unbind, i + 1));
+            stack.push_back(std::make_pair(visit, m_cells[i + 3]));
+            stack.push_back(std::make_pair(visit, m_cells[i + 2]));
+            stack.push_back(std::make_pair(bind, i + 1));
+            break;
+
+          case flat_node::letrec_group_kind:
+          {
+            cell bindings = m_cells[i + 1];
+            for(cell b = 0; b < bindings; ++b)
+            {
+              stack.push_back(std::make_pair(unbind, i + 2 + 2 * b));
+            } // end for b
+            stack.push_back(std::make_pair(visit, m_cells[i + 2 + 2 * bindings]));
+            for(cell b = 0; b < bindings; ++b)
+            {
+              stack.push_back(std::make_pair(visit, m_cells[i + 3 + 2 * b]));
+            } // end for b
+            for(cell b = 0; b < bindings; ++b)
+            {
+              stack.push_back(std::make_pair(bind, i + 2 + 2 * b));
+            } // end for b
+            break;
+          } // end case
+
+          case flat_node::record_kind:
+            for(cell f = 0; f < m_cells[i + 1]; ++f)
+            {
+              stack.push_back(std::make_pair(visit, m_cells[i + 3 + 2 * f]));
+            } // end for f
+            break;
+
+          case flat_node::selection_kind:
+            stack.push_back(std::make_pair(visit, m_cells[i + 1]));
+            break;
+        } // end switch
+      } // end while
+
+      return result;
+    } // end free_identifiers()
+
+    // returns the number of cells of the node beginning at i
+    inline cell size(const cell i) const
+    {
+      static const cell fixed[] = {2, 2, 3, 3, 4, 4, 0, 0, 3};
+
+      std::uint64_t end = i;
+
+      if(m_cells[i] < 9 && fixed[m_cells[i]])
+      {
+        end += fixed[m_cells[i]];
+      } // end if
+      else if(m_cells[i] == flat_node::record_kind)
+      {
+        // tag, n and the fields
+        end += 2;
+        if(end <= m_num_cells)
+        {
+          end += 2 * std::uint64_t(m_cells[i + 1]);
+        } // end if
+      } // end else if
+      else if(m_cells[i] == flat_node::letrec_group_kind)
+      {
+        // tag, n, the bindings, the body and the number of components
+        end += 2;
+        if(end <= m_num_cells)
+        {
+          end += 2 * std::uint64_t(m_cells[i + 1]) + 2;
+        } // end if
+
+        if(end <= m_num_cells)
+        {
+          for(cell k = 0, components = m_cells[end - 1]; k < components; ++k)
+          {
+            if(end >= m_num_cells)
+            {
+              throw bad_flat_tree("truncated node");
+            } // end if
+
+            end += 1 + std::uint64_t(m_cells[end]);
+          } // end for k
+        } // end if
+      } // end else if
+      else
+      {
+        throw bad_flat_tree("bad tag");
+      } // end else
+
+      if(end > m_num_cells)
+      {
+        throw bad_flat_tree("truncated node");
+      } // end if
+
+      return end - i;
+    } // end size()
+
+    inline void check_string(const cell i) const
+    {
+      if(m_cells[i] >= m_num_strings)
+      {
+        throw bad_flat_tree("bad string");
+      } // end if
+    } // end check_string()
+
+    inline void check_child(const std::vector<bool> &starts, const cell i) const
+    {
+      if(m_cells[i] >= starts.size() || !starts[m_cells[i]])
+      {
+        throw bad_flat_tree("bad child");
+      } // end if
+    } // end check_child()
+
+    cell        m_num_strings;
+    cell        m_num_cells;
+    cell        m_root;
+    const cell *m_string_ends;
+    const cell *m_cells;
+    const char *m_strings;
+};
+
+inline const flat_node::cell &flat_node::at(const cell i) const
+{
+  return (*m_tree)[m_index + i];
+}
+
+inline std::string flat_node::name() const
+{
+  return m_tree->string(at(1));
+}
+
+inline std::string flat_node::label() const
+{
+  return m_tree->string(at(2));
+}
+
+inline flat_bindings::binding flat_bindings::operator[](const std::size_t i) const
+{
+  return binding(m_group.m_tree->string(m_group.at(2 + 2 * i)), m_group.child(3 + 2 * i));
+}
+
+namespace detail
+{
+
+class flat_writer
+  : public boost::static_visitor<flat_node::cell>
+{
+  public:
+    typedef flat_node::cell cell;
+
+    inline cell operator()(const node &n)
+    {
+      return boost::apply_visitor(*this, n);
+    } // end operator()()
+
+    inline cell operator()(const integer_literal &il)
+    {
+      return emit({flat_node::integer_literal_kind, static_cast<cell>(il.value())});
+    } // end operator()()
+
+    inline cell operator()(const identifier &id)
+    {
+      return emit({flat_node::identifier_kind, intern(id.name())});
+    } // end operator()()
+
+    inline cell operator()(const apply &app)
+    {
+      cell fn  = (*this)(app.function());
+      cell arg = (*this)(app.argument());
+      return emit({flat_node::apply_kind, fn, arg});
+    } // end operator()()
+
+    inline cell operator()(const lambda &l)
+    {
+      cell body = (*this)(l.body());
+      return emit({flat_node::lambda_kind, intern(l.parameter()), body});
+    } // end operator()()
+
+    inline cell operator()(const let &l)
+    {
+      cell def  = (*this)(l.definition());
+      cell body = (*this)(l.body());
+      return emit({flat_node::let_kind, intern(l.name()), def, body});
+    } // end operator()()
+
+    inline cell operator()(const letrec &l)
+    {
+      cell def  = (*this)(l.definition());
+      cell body = (*this)(l.body());
+      return emit({flat_node::letrec_kind, intern(l.name()), def, body});
+    } // end operator()()
+
+    inline cell operator()(const letrec_group &l)
+    {
+      auto &bindings = l.bindings();
+      auto graph = analyze_dependencies(bindings);
+
+      std::vector<cell> cells;
+      cells.push_back(flat_node::letrec_group_kind);
+      cells.push_back(bindings.size());
+
+      for(auto i = bindings.begin(); i != bindings.end(); ++i)
+      {
+        cell def = (*this)(i->second);
+        cells.push_back(intern(i->first));
+        cells.push_back(def);
+      } // end for i
+
+      cells.push_back((*this)(l.body()));
+
+      cells.push_back(graph.m_components.size());
+      for(auto c = graph.m_components.begin(); c != graph.m_components.end(); ++c)
+      {
+        cells.push_back(c->size());
+        cells.insert(cells.end(), c->begin(), c->end());
+      } // end for c
+
+      return emit(cells);
+    } // end operator()()
+
+    inline cell operator()(const record &r)
+    {
+      auto &fields = r.fields();
+
+      std::vector<cell> cells;
+      cells.push_back(flat_node::record_kind);
+      cells.push_back(fields.size());
+
+      for(auto i = fields.begin(); i != fields.end(); ++i)
+      {
+        cell value = (*this)(i->second);
+        cells.push_back(intern(i->first));
+        cells.push_back(value);
+      } // end for i
+
+      return emit(cells);
+    } // end operator()()
+
+    inline cell operator()(const selection &s)
+    {
+      cell rec = (*this)(s.record());
+      return emit({flat_node::selection_kind, rec, intern(s.label())});
+    } // end operator()()
+
+    // returns the encoding of a tree whose root is at root
+    inline std::string finish(const cell root) const
+    {
+      std::string bytes;
+      std::vector<cell> ends;
+      for(auto i = m_strings.begin(); i != m_strings.end(); ++i)
+      {
+        bytes += *i;
+        ends.push_back(bytes.size());
+      } // end for i
+
+      cell header[] = {static_cast<cell>(m_strings.size()), static_cast<cell>(m_cells.size()), root};
+
+      std::string result("hmast001");
+      append(result, header, 3);
+      append(result, ends.data(), ends.size());
+      append(result, m_cells.data(), m_cells.size());
+      return result + bytes;
+    } // end finish()
+
+  private:
+    inline static void append(std::string &s, const cell *cells, const std::size_t n)
+    {
+      s.append(reinterpret_cast<const char*>(cells), n * sizeof(cell));
+    } // end append()
+
+    inline cell emit(const std::vector<cell> &cells)
+    {
+      cell result = m_cells.size();
+      m_cells.insert(m_cells.end(), cells.begin(), cells.end());
+      return result;
+    } // end emit()
+
+    inline cell intern(const std::string &s)
+    {
+      auto iter = m_index.find(s);
+      if(iter == m_index.end())
+      {
+        iter = m_index.insert(std::make_pair(s, static_cast<cell>(m_strings.size()))).first;
+        m_strings.push_back(s);
+      } // end if
+
+      return iter->second;
+    } // end intern()
+
+    std::vector<cell>           m_cells;
+    std::vector<std::string>    m_strings;
+    std::map<std::string, cell> m_index;
+}; // end flat_writer
+
+} // end detail
+
+// returns the flat encoding of n, each distinct name of which is stored once
+inline std::string flatten(const node &n)
+{
+  detail::flat_writer writer;
+  auto root = writer(n);
+  return writer.finish(root);
+} // end flatten()
+
+// a read-only mapping of a file, such as a tree written by flatten()
+class mapped_file
+{
+  public:
+    inline mapped_file(const std::string &path)
+      : m_data(0),
+        m_size(0)
+    {
+      int fd = open(path.c_str(), O_RDONLY);
+      struct stat s;
+      if(fd < 0 || fstat(fd, &s) < 0)
+      {
+        if(fd >= 0) close(fd);
+        throw std::runtime_error("couldn't open " + path);
+      } // end if
+
+      m_size = s.st_size;
+      if(m_size)
+      {
+        m_data = mmap(0, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      } // end if
+      close(fd);
+
+      if(m_data == MAP_FAILED)
+      {
+        throw std::runtime_error("couldn't map " + path);
+      } // end if
+    } // end mapped_file()
+
+    inline ~mapped_file()
+    {
+      if(m_data)
+      {
+        munmap(m_data, m_size);
+      } // end if
+    } // end ~mapped_file()
+
+    inline const void *data(void) const
+    {
+      return m_data;
+    } // end data()
+
+    inline std::size_t size(void) const
+    {
+      return m_size;
+    } // end size()
+
+  private:
+    mapped_file(const mapped_file &);
+    mapped_file &operator=(const mapped_file &);
+
+    void        *m_data;
+    std::size_t  m_size;
+};
+
+} // end syntax
@@ -0,0 +1,215 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "unification.hpp"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define UNIFICATION_FLAT_TYPE_X86
+#endif
+
+namespace unification
+{
+
+namespace detail
+{
+
+// returns a pointer to the first cell of [first,last) equal to value, or last
+
+inline const std::uint32_t *find_cell_scalar(const std::uint32_t *first, const std::uint32_t *last, const std::uint32_t value)
+{
+  for(; first != last && *first != value; ++first)
+    ;
+
+  return first;
+} // end find_cell_scalar()
+
+#ifdef UNIFICATION_FLAT_TYPE_X86
+inline const std::uint32_t *find_cell_sse2(const std::uint32_t *first, const std::uint32_t *last, const std::uint32_t value)
+{
+  const __m128i needle = _mm_set1_epi32(value);
+
+  for(; last - first >= 4; first += 4)
+  {
+    __m128i cells = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+    int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(cells, needle)));
+    if(mask)
+    {
+      return first + __builtin_ctz(mask);
+    } // end if
+  } // end for
+
+  return find_cell_scalar(first, last, value);
+} // end find_cell_sse2()
+
+__attribute__((target("avx2")))
+inline const std::uint32_t *find_cell_avx2(const std::uint32_t *first, const std::uint32_t *last, const std::uint32_t value)
+{
+  const __m256i needle = _mm256_set1_epi32(value);
+
+  // compare 32 cells per iteration and look for the match only once one is found
+  for(; last - first >= 32; first += 32)
+  {
+    __m256i a = _mm256_cmpeq_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(first)),      needle);
+    __m256i b = _mm256_cmpeq_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(first + 8)),  needle);
+    __m256i c = _mm256_cmpeq_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(first + 16)), needle);
+    __m256i d = _mm256_cmpeq_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(first + 24)), needle);
+
+    if(!_mm256_testz_si256(_mm256_or_si256(_mm256_or_si256(a, b), _mm256_or_si256(c, d)), _mm256_set1_epi32(-1)))
+    {
+      break;
+    } // end if
+  } // end for
+
+  for(; last - first >= 8; first += 8)
+  {
+    __m256i cells = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+    int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(cells, needle)));
+    if(mask)
+    {
+      return first + __builtin_ctz(mask);
+    } // end if
+  } // end for
+
+  return find_cell_scalar(first, last, value);
+} // end find_cell_avx2()
+#endif
+
+// chooses the widest scan the processor supports
+inline const std::uint32_t *find_cell(const std::uint32_t *first, const std::uint32_t *last, const std::uint32_t value)
+{
+#ifdef UNIFICATION_FLAT_TYPE_X86
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  return has_avx2 ? find_cell_avx2(first, last, value) : find_cell_sse2(first, last, value);
+#else
+  return find_cell_scalar(first, last, value);
+#endif
+} // end find_cell()
+
+} // end detail
+
+// a flat_type encodes a sequence of types as one contiguous preorder array of
+// 32-bit cells, so that asking whether a variable occurs anywhere in them is
+// a linear scan rather than a walk through recursive_wrappers
+//
+// a type_operator is one cell holding its kind and arity, followed by the
+// cells of its arguments. a type_variable is one cell with its high bit set
+// holding its id relative to the first variable encoded, so the variables of
+// a flat_type must lie within 2^30 of each other. kinds must be below 2^24
+// and arities below 128. append() reports a type which does not fit, and the
+// caller should fall back to walking the type itself
+class flat_type
+{
+  public:
+    typedef std::uint32_t cell;
+
+    inline flat_type()
+      : m_base(0),
+        m_has_base(false)
+    {}
+
+    // appends the encoding of x, resolved through substitution
+    // returns false if x cannot be encoded, after which the flat_type must
+    // not be used until clear()ed
+    inline bool append(const type &x, const substitution_map &substitution)
+    {
+      auto &walked = workspace::walk(x, substitution);
+
+      if(auto var = boost::get<type_variable>(&walked))
+      {
+        if(!m_has_base)
+        {
+          m_base = var->id();
+          m_has_base = true;
+        } // end if
+
+        cell c;
+        if(!encode(*var, c))
+        {
+          return false;
+        } // end if
+
+        m_cells.push_back(c);
+        return true;
+      } // end if
+
+      auto &op = boost::get<type_operator>(walked);
+      if(op.kind() > max_kind || op.size() > max_arity)
+      {
+        return false;
+      } // end if
+
+      m_cells.push_back(cell(op.kind()) | (cell(op.size()) << arity_shift));
+
+      for(auto i = op.begin();
+          i != op.end();
+          ++i)
+      {
+        if(!append(*i, substitution))
+        {
+          return false;
+        } // end if
+      } // end for i
+
+      return true;
+    } // end append()
+
+    // returns true if var occurs in any of the types appended
+    inline bool contains(const type_variable &var) const
+    {
+      cell c;
+      if(!encode(var, c))
+      {
+        // every variable encoded lies within range of the base
+        return false;
+      } // end if
+
+      auto first = m_cells.data();
+      auto last = first + m_cells.size();
+      return detail::find_cell(first, last, c) != last;
+    } // end contains()
+
+    // returns the number of cells
+    inline std::size_t size(void) const
+    {
+      return m_cells.size();
+    } // end size()
+
+    inline void clear(void)
+    {
+      m_cells.clear();
+      m_has_base = false;
+    } // end clear()
+
+  private:
+    static const cell        variable_tag = cell(1) << 31;
+    static const std::size_t bias         = std::size_t(1) << 30;
+    static const std::size_t max_kind     = (std::size_t(1) << 24) - 1;
+    static const std::size_t max_arity    = 127;
+    static const int         arity_shift  = 24;
+
+    inline bool encode(const type_variable &var, cell &result) const
+    {
+      if(!m_has_base || var.id() + bias < m_base)
+      {
+        return false;
+      } // end if
+
+      std::size_t offset = var.id() + bias - m_base;
+      if(offset >= variable_tag)
+      {
+        return false;
+      } // end if
+
+      result = variable_tag | cell(offset);
+      return true;
+    } // end encode()
+
+    std::vector<cell, scratch_allocator<cell>> m_cells;
+    std::size_t                                m_base;
+    bool                                       m_has_base;
+}; // end flat_type
+
+} // end unification
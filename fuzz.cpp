@@ -0,0 +1,279 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <set>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include "unification.hpp"
+#include "syntax.hpp"
+#include "parser.hpp"
+#include "inference.hpp"
+#include "prelude.hpp"
+#include "fuzzer.hpp"
+
+// searches for small programs whose types are disproportionately expensive
+// to infer against the demo's prelude
+//
+// a population of random programs evolves toward the greatest work per
+// node, as counted by a unification::budget. the worst programs found are
+// minimized and written to directory, one expression per file, as
+// regression benchmarks
+//
+//   $ ./fuzz [--seed n] [--generations n] [--population n] [--max-nodes n] [--keep n] directory
+//
+// --replay measures and times saved programs
+//
+//   $ ./fuzz --replay directory/*.hm
+
+struct options
+{
+  inline options()
+    : m_seed(1),
+      m_generations(10000),
+      m_population(64),
+      m_max_nodes(40),
+      m_keep(5),
+      m_limit(1000000)
+  {}
+
+  std::uint64_t m_seed;
+  std::size_t   m_generations;
+  std::size_t   m_population;
+  std::size_t   m_max_nodes;
+  std::size_t   m_keep;
+  // the work after which inference of a program is abandoned
+  std::size_t   m_limit;
+}; // end options
+
+struct candidate
+{
+  syntax::node   m_program;
+  fuzzing::cost  m_cost;
+  std::string    m_text;
+}; // end candidate
+
+inline std::string text(const syntax::node &n)
+{
+  std::ostringstream os;
+  os << n;
+  return os.str();
+} // end text()
+
+inline void print(std::ostream &os, const fuzzing::cost &c)
+{
+  os << c.m_nodes << "\t" << c.m_work << "\t" << c.per_node() << "\t" << (c.m_exhausted ? "exhausted" : c.m_well_typed ? "well-typed" : "ill-typed");
+} // end print()
+
+// a file which can't be read or parsed is reported, and the rest are still
+// replayed
+inline int replay(int argc, char **argv, const options &o)
+{
+  auto env = inference::prelude();
+  int result = 0;
+
+  std::cout << "file\tnodes\twork\twork per node\tresult\tns per inference" << std::endl;
+
+  for(int i = 0; i < argc; ++i)
+  {
+    std::ifstream file(argv[i]);
+    if(!file)
+    {
+      std::cerr << "couldn't open " << argv[i] << ": " << std::strerror(errno) << std::endl;
+      result = 1;
+      continue;
+    } // end if
+
+    std::stringstream contents;
+    contents << file.rdbuf();
+
+    try
+    {
+      auto program = syntax::parse(contents.str());
+      auto c = fuzzing::measure(program, env, o.m_limit);
+
+      // repeat for at least 10ms
+      std::size_t runs = 0;
+      auto start = std::chrono::steady_clock::now();
+      std::chrono::duration<double, std::nano> elapsed(0);
+      while(elapsed.count() < 1e7)
+      {
+        fuzzing::measure(program, env, o.m_limit);
+        ++runs;
+        elapsed = std::chrono::steady_clock::now() - start;
+      } // end while
+
+      std::cout << argv[i] << "\t";
+      print(std::cout, c);
+      std::cout << "\t" << elapsed.count() / runs << std::endl;
+    } // end try
+    catch(const std::exception &e)
+    {
+      std::cerr << argv[i] << ": " << e.what() << std::endl;
+      result = 1;
+    } // end catch
+  } // end for i
+
+  return result;
+} // end replay()
+
+inline int fuzz(const std::string &directory, const options &o)
+{
+  auto env = inference::prelude();
+  auto scope = fuzzing::names(env);
+  fuzzing::generator g(scope, o.m_seed);
+
+  std::vector<candidate> population;
+  std::set<std::string> seen;
+
+  auto consider = [&](syntax::node &&program)
+  {
+    auto t = text(program);
+    if(fuzzing::size(program) > o.m_max_nodes || !seen.insert(t).second) return;
+
+    auto c = fuzzing::measure(program, env, o.m_limit);
+
+    if(population.size() < o.m_population)
+    {
+      population.push_back(candidate{std::move(program), c, t});
+      return;
+    } // end if
+
+    // a variation replaces the cheapest member of the population if it beats it
+    auto cheapest = std::min_element(population.begin(), population.end(), [](const candidate &x, const candidate &y)
+    {
+      return x.m_cost.per_node() < y.m_cost.per_node();
+    });
+
+    if(c.per_node() > cheapest->m_cost.per_node())
+    {
+      *cheapest = candidate{std::move(program), c, t};
+    } // end if
+  }; // end consider
+
+  // a small --max-nodes admits few distinct programs, so the population may
+  // never fill, and the search goes on with what was found
+  for(std::size_t attempts = 0;
+      population.size() < o.m_population && attempts < 100 * o.m_population;
+      ++attempts)
+  {
+    std::vector<std::string> s = scope;
+    consider(g.expression(4, s));
+  } // end for attempts
+
+  if(population.empty())
+  {
+    throw std::runtime_error("no program of at most " + std::to_string(o.m_max_nodes) + " nodes was generated; raise --max-nodes");
+  } // end if
+
+  // parents are chosen by tournament
+  auto tournament = [&]() -> const candidate&
+  {
+    const candidate *result = &population[g.pick(population.size())];
+    for(int i = 0; i < 2; ++i)
+    {
+      auto &other = population[g.pick(population.size())];
+      if(other.m_cost.per_node() > result->m_cost.per_node()) result = &other;
+    } // end for i
+
+    return *result;
+  }; // end tournament
+
+  for(std::size_t generation = 1; generation <= o.m_generations; ++generation)
+  {
+    auto &parent = tournament();
+    auto &donor = tournament();
+    consider(g.mutate(parent.m_program, donor.m_program, scope, 3));
+
+    if(generation % 1000 == 0)
+    {
+      auto best = std::max_element(population.begin(), population.end(), [](const candidate &x, const candidate &y)
+      {
+        return x.m_cost.per_node() < y.m_cost.per_node();
+      });
+
+      std::cerr << "generation " << generation << ": best " << best->m_cost.per_node() << " work per node" << std::endl;
+    } // end if
+  } // end for generation
+
+  std::sort(population.begin(), population.end(), [](const candidate &x, const candidate &y)
+  {
+    return x.m_cost.per_node() > y.m_cost.per_node();
+  });
+
+  std::cout << "file\tnodes\twork\twork per node\tresult" << std::endl;
+
+  // minimizing keeps at least 90% of a program's work per node
+  // programs of the same size which do the same work are likely variations
+  // of each other, so only the first is kept
+  std::set<std::pair<std::size_t,std::size_t>> written;
+  for(std::size_t i = 0; i < population.size() && written.size() < o.m_keep; ++i)
+  {
+    auto minimized = fuzzing::minimize(population[i].m_program, 0.9 * population[i].m_cost.per_node(), env, o.m_limit);
+    auto c = fuzzing::measure(minimized, env, o.m_limit);
+    if(!written.insert(std::make_pair(c.m_nodes, c.m_work)).second) continue;
+
+    auto filename = directory + "/worst-" + std::to_string(written.size()) + ".hm";
+    std::ofstream file(filename);
+    file << minimized << std::endl;
+    if(!file)
+    {
+      std::cerr << "couldn't write " << filename << ": " << std::strerror(errno) << std::endl;
+      return 1;
+    } // end if
+
+    std::cout << filename << "\t";
+    print(std::cout, c);
+    std::cout << std::endl;
+  } // end for i
+
+  return 0;
+} // end fuzz()
+
+int main(int argc, char **argv)
+{
+  const char *program = argv[0];
+  options o;
+
+  auto usage = [=]
+  {
+    std::cerr << "usage: " << program << " [--seed n] [--generations n] [--population n] [--max-nodes n] [--keep n] directory" << std::endl;
+    std::cerr << "       " << program << " --replay file..." << std::endl;
+    return 1;
+  };
+
+  if(argc > 1 && !std::strcmp(argv[1], "--replay"))
+  {
+    return replay(argc - 2, argv + 2, o);
+  } // end if
+
+  for(; argc > 2 && !std::strncmp(argv[1], "--", 2); argc -= 2, argv += 2)
+  {
+    std::size_t value = std::strtoull(argv[2], 0, 10);
+
+    if(!std::strcmp(argv[1], "--seed")) o.m_seed = value;
+    else if(!std::strcmp(argv[1], "--generations")) o.m_generations = value;
+    else if(!std::strcmp(argv[1], "--population") && value > 0) o.m_population = value;
+    else if(!std::strcmp(argv[1], "--max-nodes") && value > 0) o.m_max_nodes = value;
+    else if(!std::strcmp(argv[1], "--keep")) o.m_keep = value;
+    else return usage();
+  } // end for
+
+  if(argc != 2)
+  {
+    return usage();
+  } // end if
+
+  try
+  {
+    return fuzz(argv[1], o);
+  } // end try
+  catch(const std::exception &e)
+  {
+    std::cerr << "error: " << e.what() << std::endl;
+    return 1;
+  } // end catch
+}
@@ -0,0 +1,532 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <set>
+#include <random>
+#include <algorithm>
+#include <functional>
+#include <boost/variant.hpp>
+#include "unification.hpp"
+#include "syntax.hpp"
+#include "dependencies.hpp"
+#include "inference.hpp"
+
+namespace fuzzing
+{
+
+// the cost of inferring the type of a program, from the counters of a
+// unification::budget
+//
+// m_work is the sum of the unify iterations, which include the nodes visited
+// by occurs checks, the fresh variables and the type nodes inference spent.
+// a program whose inference is linear in its size spends roughly the same
+// work per node however large it is
+struct cost
+{
+  inline cost()
+    : m_nodes(0),
+      m_work(0),
+      m_well_typed(false),
+      m_exhausted(false)
+  {}
+
+  inline double per_node(void) const
+  {
+    return m_nodes ? static_cast<double>(m_work) / m_nodes : 0;
+  } // end per_node()
+
+  std::size_t m_nodes;
+  std::size_t m_work;
+  bool        m_well_typed;
+  // inference was abandoned after spending the limit
+  bool        m_exhausted;
+}; // end cost
+
+// a subterm of a program and the names in scope where it occurs
+struct subterm
+{
+  const syntax::node       *m_node;
+  std::vector<std::string>  m_scope;
+}; // end subterm
+
+// returns the names bound by env
+inline std::vector<std::string> names(const inference::environment &env)
+{
+  std::vector<std::string> result;
+  for(auto i = env.begin(); i != env.end(); ++i)
+  {
+    result.push_back(i->first);
+  } // end for i
+
+  return result;
+} // end names()
+
+namespace detail
+{
+
+// lists the subterms of a tree in preorder
+class subterm_collector
+  : public boost::static_visitor<>
+{
+  public:
+    inline subterm_collector(std::vector<subterm> &result, const std::vector<std::string> &scope)
+      : m_result(result),
+        m_scope(scope)
+    {}
+
+    inline void operator()(const syntax::node &n)
+    {
+      m_result.push_back(subterm{&n, m_scope});
+      boost::apply_visitor(*this, n);
+    } // end operator()()
+
+    inline void operator()(const syntax::integer_literal &) {}
+
+    inline void operator()(const syntax::identifier &) {}
+
+    inline void operator()(const syntax::apply &app)
+    {
+      (*this)(app.function());
+      (*this)(app.argument());
+    } // end operator()()
+
+    inline void operator()(const syntax::lambda &l)
+    {
+      m_scope.push_back(l.parameter());
+      (*this)(l.body());
+      m_scope.pop_back();
+    } // end operator()()
+
+    inline void operator()(const syntax::let &l)
+    {
+      (*this)(l.definition());
+      m_scope.push_back(l.name());
+      (*this)(l.body());
+      m_scope.pop_back();
+    } // end operator()()
+
+    inline void operator()(const syntax::letrec &l)
+    {
+      m_scope.push_back(l.name());
+      (*this)(l.definition());
+      (*this)(l.body());
+      m_scope.pop_back();
+    } // end operator()()
+
+    inline void operator()(const syntax::letrec_group &g)
+    {
+      for(auto i = g.bindings().begin(); i != g.bindings().end(); ++i)
+      {
+        m_scope.push_back(i->first);
+      } // end for i
+
+      for(auto i = g.bindings().begin(); i != g.bindings().end(); ++i)
+      {
+        (*this)(i->second);
+      } // end for i
+      (*this)(g.body());
+
+      m_scope.resize(m_scope.size() - g.bindings().size());
+    } // end operator()()
+
+    inline void operator()(const syntax::record &r)
+    {
+      for(auto i = r.fields().begin(); i != r.fields().end(); ++i)
+      {
+        (*this)(i->second);
+      } // end for i
+    } // end operator()()
+
+    inline void operator()(const syntax::selection &s)
+    {
+      (*this)(s.record());
+    } // end operator()()
+
+  private:
+    std::vector<subterm>     &m_result;
+    std::vector<std::string>  m_scope;
+}; // end subterm_collector
+
+// copies a tree with its subterm at a preorder index replaced
+class subterm_replacer
+  : public boost::static_visitor<syntax::node>
+{
+  public:
+    inline subterm_replacer(const std::size_t target, const syntax::node &replacement)
+      : m_target(target),
+        m_index(0),
+        m_replacement(replacement)
+    {}
+
+    inline syntax::node operator()(const syntax::node &n)
+    {
+      if(m_index++ == m_target)
+      {
+        return m_replacement;
+      } // end if
+
+      return boost::apply_visitor(*this, n);
+    } // end operator()()
+
+    inline syntax::node operator()(const syntax::integer_literal &x)
+    {
+      return x;
+    } // end operator()()
+
+    inline syntax::node operator()(const syntax::identifier &x)
+    {
+      return x;
+    } // end operator()()
+
+    inline syntax::node operator()(const syntax::apply &app)
+    {
+      auto function = (*this)(app.function());
+      return syntax::apply(std::move(function), (*this)(app.argument()));
+    } // end operator()()
+
+    inline syntax::node operator()(const syntax::lambda &l)
+    {
+      return syntax::lambda(l.parameter(), (*this)(l.body()));
+    } // end operator()()
+
+    inline syntax::node operator()(const syntax::let &l)
+    {
+      auto definition = (*this)(l.definition());
+      return syntax::let(l.name(), std::move(definition), (*this)(l.body()));
+    } // end operator()()
+
+    inline syntax::node operator()(const syntax::letrec &l)
+    {
+      auto definition = (*this)(l.definition());
+      return syntax::letrec(l.name(), std::move(definition), (*this)(l.body()));
+    } // end operator()()
+
+    inline syntax::node operator()(const syntax::letrec_group &g)
+    {
+      std::vector<syntax::letrec_group::binding> bindings;
+      for(auto i = g.bindings().begin(); i != g.bindings().end(); ++i)
+      {
+        bindings.push_back(syntax::letrec_group::binding(i->first, (*this)(i->second)));
+      } // end for i
+
+      return syntax::letrec_group(std::move(bindings), (*this)(g.body()));
+    } // end operator()()
+
+    inline syntax::node operator()(const syntax::record &r)
+    {
+      std::vector<syntax::record::field> fields;
+      for(auto i = r.fields().begin(); i != r.fields().end(); ++i)
+      {
+        fields.push_back(syntax::record::field(i->first, (*this)(i->second)));
+      } // end for i
+
+      return syntax::record(std::move(fields));
+    } // end operator()()
+
+    inline syntax::node operator()(const syntax::selection &s)
+    {
+      return syntax::selection((*this)(s.record()), s.label());
+    } // end operator()()
+
+  private:
+    std::size_t         m_target;
+    std::size_t         m_index;
+    const syntax::node &m_replacement;
+}; // end subterm_replacer
+
+} // end detail
+
+// returns the subterms of n in preorder, where scope is in scope at n
+inline std::vector<subterm> subterms(const syntax::node &n, const std::vector<std::string> &scope)
+{
+  std::vector<subterm> result;
+  detail::subterm_collector collect(result, scope);
+  collect(n);
+  return result;
+} // end subterms()
+
+// returns the number of nodes of n
+inline std::size_t size(const syntax::node &n)
+{
+  std::size_t result = 1;
+  auto c = syntax::children(n);
+  for(auto i = c.begin(); i != c.end(); ++i)
+  {
+    result += size(**i);
+  } // end for i
+
+  return result;
+} // end size()
+
+// returns a copy of n with its i-th subterm in preorder replaced
+inline syntax::node replace(const syntax::node &n, const std::size_t i, const syntax::node &replacement)
+{
+  detail::subterm_replacer r(i, replacement);
+  return r(n);
+} // end replace()
+
+// returns true if every identifier free in n is in scope
+inline bool scoped(const syntax::node &n, const std::vector<std::string> &scope)
+{
+  auto free = syntax::free_identifiers(n);
+  return std::all_of(free.begin(), free.end(), [&](const std::string &name)
+  {
+    return std::find(scope.begin(), scope.end(), name) != scope.end();
+  });
+} // end scoped()
+
+// infers the type of n, giving up once any counter of the budget exceeds limit
+inline cost measure(const syntax::node &n, const inference::environment &env, const std::size_t limit)
+{
+  cost result;
+  result.m_nodes = size(n);
+
+  unification::budget b;
+  b.limit(unification::budget::unify_iterations, limit)
+   .limit(unification::budget::type_nodes, limit)
+   .limit(unification::budget::fresh_variables, limit);
+
+  try
+  {
+    result.m_exhausted = !inference::infer_type(n, env, b);
+    result.m_well_typed = !result.m_exhausted;
+  } // end try
+  catch(const std::runtime_error &)
+  {
+    // ill-typed programs are measured up to the error
+  } // end catch
+
+  result.m_work = b.used(unification::budget::unify_iterations) +
+                  b.used(unification::budget::fresh_variables) +
+                  b.used(unification::budget::type_nodes);
+
+  return result;
+} // end measure()
+
+// makes random programs in which every identifier is in scope, and random
+// variations of them
+class generator
+{
+  public:
+    inline generator(const std::vector<std::string> &builtins, const std::uint64_t seed)
+      : m_builtins(builtins),
+        m_random(seed),
+        m_next_name(0)
+    {}
+
+    // returns a random expression of at most the given depth, whose free
+    // identifiers are among scope and the builtins
+    inline syntax::node expression(const std::size_t depth, std::vector<std::string> &scope)
+    {
+      if(depth == 0 || chance(1, 4))
+      {
+        return leaf(scope);
+      } // end if
+
+      switch(pick(10))
+      {
+        case 0:
+        case 1:
+        case 2:
+        case 3:
+        {
+          auto function = expression(depth - 1, scope);
+          return syntax::apply(std::move(function), expression(depth - 1, scope));
+        } // end case
+
+        case 4:
+        case 5:
+        {
+          auto name = fresh_name();
+          scope.push_back(name);
+          auto body = expression(depth - 1, scope);
+          scope.pop_back();
+          return syntax::lambda(name, std::move(body));
+        } // end case
+
+        case 6:
+        case 7:
+        {
+          auto name = fresh_name();
+          auto definition = expression(depth - 1, scope);
+          scope.push_back(name);
+          auto body = expression(depth - 1, scope);
+          scope.pop_back();
+          return syntax::let(name, std::move(definition), std::move(body));
+        } // end case
+
+        case 8:
+        {
+          auto name = fresh_name();
+          scope.push_back(name);
+          auto definition = expression(depth - 1, scope);
+          auto body = expression(depth - 1, scope);
+          scope.pop_back();
+          return syntax::letrec(name, std::move(definition), std::move(body));
+        } // end case
+
+        default:
+        {
+          if(chance(1, 2))
+          {
+            return syntax::selection(expression(depth - 1, scope), label());
+          } // end if
+
+          std::vector<syntax::record::field> fields;
+          std::vector<std::string> labels{"a", "b", "c"};
+          std::shuffle(labels.begin(), labels.end(), m_random);
+          for(std::size_t i = 0, n = 1 + pick(3); i < n; ++i)
+          {
+            fields.push_back(syntax::record::field(labels[i], expression(depth - 1, scope)));
+          } // end for i
+
+          return syntax::record(std::move(fields));
+        } // end default
+      } // end switch
+    } // end expression()
+
+    // returns a variation of n: one of its subterms is replaced by a random
+    // expression, by one of its own subterms, by a subterm of donor, or is
+    // bound by a let whose body uses it
+    inline syntax::node mutate(const syntax::node &n, const syntax::node &donor, const std::vector<std::string> &scope, const std::size_t depth)
+    {
+      auto targets = subterms(n, scope);
+      auto &target = targets[pick(targets.size())];
+      auto target_scope = target.m_scope;
+
+      switch(pick(4))
+      {
+        case 0:
+          return replace(n, &target - targets.data(), expression(depth, target_scope));
+
+        case 1:
+        {
+          // hoist a descendant which is in scope here
+          auto inner = subterms(*target.m_node, target_scope);
+          auto &hoisted = inner[pick(inner.size())];
+          if(scoped(*hoisted.m_node, target_scope))
+          {
+            return replace(n, &target - targets.data(), *hoisted.m_node);
+          } // end if
+
+          return n;
+        } // end case
+
+        case 2:
+        {
+          // graft a subterm of donor which is in scope here
+          auto grafts = subterms(donor, scope);
+          auto &graft = grafts[pick(grafts.size())];
+          if(scoped(*graft.m_node, target_scope))
+          {
+            return replace(n, &target - targets.data(), *graft.m_node);
+          } // end if
+
+          return n;
+        } // end case
+
+        default:
+        {
+          // let x = e in b, where b is likely to use x
+          auto name = fresh_name();
+          target_scope.push_back(name);
+          auto body = expression(depth, target_scope);
+          if(chance(1, 2))
+          {
+            body = syntax::apply(syntax::identifier(name), std::move(body));
+          } // end if
+
+          return replace(n, &target - targets.data(), syntax::let(name, *target.m_node, std::move(body)));
+        } // end default
+      } // end switch
+    } // end mutate()
+
+    // returns a random integer in [0, n)
+    inline std::size_t pick(const std::size_t n)
+    {
+      return std::uniform_int_distribution<std::size_t>(0, n - 1)(m_random);
+    } // end pick()
+
+  private:
+    inline bool chance(const std::size_t numerator, const std::size_t denominator)
+    {
+      return pick(denominator) < numerator;
+    } // end chance()
+
+    inline syntax::node leaf(const std::vector<std::string> &scope)
+    {
+      // prefer the innermost bindings, which make deeper sharing
+      if(!scope.empty() && chance(2, 3))
+      {
+        std::size_t from_end = std::min(pick(4), scope.size() - 1);
+        return syntax::identifier(scope[scope.size() - 1 - from_end]);
+      } // end if
+      else if(!m_builtins.empty() && chance(2, 3))
+      {
+        return syntax::identifier(m_builtins[pick(m_builtins.size())]);
+      } // end else if
+
+      return syntax::integer_literal(static_cast<int>(pick(10)));
+    } // end leaf()
+
+    inline std::string label(void)
+    {
+      static const char *labels[] = {"a", "b", "c"};
+      return labels[pick(3)];
+    } // end label()
+
+    inline std::string fresh_name(void)
+    {
+      return "v" + std::to_string(m_next_name++);
+    } // end fresh_name()
+
+    std::vector<std::string> m_builtins;
+    std::mt19937_64          m_random;
+    std::size_t              m_next_name;
+}; // end generator
+
+// returns a smaller program which still costs at least threshold per node,
+// by repeatedly replacing a subterm with one of its children or with 0
+inline syntax::node minimize(syntax::node n, const double threshold, const inference::environment &env, const std::size_t limit)
+{
+  auto scope = names(env);
+
+  for(bool shrunk = true; shrunk; )
+  {
+    shrunk = false;
+
+    auto current = subterms(n, scope);
+    for(std::size_t i = 0; !shrunk && i < current.size(); ++i)
+    {
+      std::vector<syntax::node> candidates;
+      auto c = syntax::children(*current[i].m_node);
+      for(auto j = c.begin(); j != c.end(); ++j)
+      {
+        if(scoped(**j, current[i].m_scope))
+        {
+          candidates.push_back(**j);
+        } // end if
+      } // end for j
+
+      if(!c.empty())
+      {
+        candidates.push_back(syntax::integer_literal(0));
+      } // end if
+
+      for(auto j = candidates.begin(); !shrunk && j != candidates.end(); ++j)
+      {
+        auto smaller = replace(n, i, *j);
+        if(measure(smaller, env, limit).per_node() >= threshold)
+        {
+          n = std::move(smaller);
+          shrunk = true;
+        } // end if
+      } // end for j
+    } // end for i
+  } // end for
+
+  return n;
+} // end minimize()
+
+} // end fuzzing
@@ -1,13 +1,24 @@
 #pragma once
 
 #include <map>
+#include <deque>
+#include <vector>
+#include <stdexcept>
 #include <set>
+#include <unordered_map>
 #include <algorithm>
 #include <string>
 #include <utility>
+#include <memory>
 #include <boost/variant/static_visitor.hpp>
 #include "unification.hpp"
 #include "syntax.hpp"
+#include "alpha.hpp"
+#include "dependencies.hpp"
+#include "flat.hpp"
+#include "flat_type.hpp"
+#include "trace.hpp"
+#include "profiler.hpp"
 
 namespace inference
 {
@@ -15,8 +26,10 @@ namespace inference
 using unification::type;
 using unification::type_variable;
 using unification::type_operator;
+using unification::substitution_map;
+using unification::variable_set;
 
-std::ostream &operator<<(std::ostream &os, const std::set<type_variable> &x)
+std::ostream &operator<<(std::ostream &os, const variable_set &x)
 {
   for(auto i = x.begin();
       i != x.end();
@@ -28,7 +41,8 @@ std::ostream &operator<<(std::ostream &os, const std::set<type_variable> &x)
   return os;
 }
 
-std::ostream &operator<<(std::ostream &os, const std::map<type_variable,type_variable> &x)
+template<typename Compare, typename Allocator>
+std::ostream &operator<<(std::ostream &os, const std::map<type_variable,type_variable,Compare,Allocator> &x)
 {
   os << "{";
   for(auto i = x.begin();
@@ -52,29 +66,166 @@ static const int pair     = 3;
 
 }
 
-inline type make_function(const type &arg,
-                          const type &result)
+// the constructor_registry records the name, arity and notation of every kind
+// of type_operator, so that printers and readers of types needn't hard-code
+// the builtin kinds
+//
+// it also keeps an instance of each nullary constructor, but that saves no
+// allocation: a type holds its type_operator through a recursive_wrapper, so
+// every copy of an instance into an environment, substitution or operand is
+// a fresh heap copy, as it would be of a newly built type
+class constructor_registry
 {
-  return type_operator(types::function, {arg, result});
+  public:
+    typedef type_operator::kind_type kind_type;
+
+    inline constructor_registry()
+    {
+      // the builtin constructors must be declared in the order of their ids in types
+      declare("int",  0);
+      declare("bool", 0);
+      declare("->",   2, true);
+      declare("*",    2, true);
+    } // end constructor_registry()
+
+    // user constructors should be declared before inference begins
+    inline kind_type declare(const std::string &name,
+                             const std::size_t arity,
+                             const bool infix = false)
+    {
+      kind_type result = m_constructors.size();
+
+      if(infix && arity != 2)
+      {
+        throw std::invalid_argument("constructor_registry::declare(): only binary constructors may be infix");
+      } // end if
+
+      // nullary constructors get their canonical instance here, which must
+      // outlive whatever resource the caller has made current
+      unification::scoped_resource scope(*std::pmr::new_delete_resource());
+      m_constructors.push_back(constructor(name, arity, infix, type_operator(result)));
+
+      return result;
+    } // end declare()
+
+    inline bool contains(const kind_type &kind) const
+    {
+      return kind < m_constructors.size();
+    } // end contains()
+
+    inline const std::string &name(const kind_type &kind) const
+    {
+      return lookup(kind).m_name;
+    } // end name()
+
+    inline std::size_t arity(const kind_type &kind) const
+    {
+      return lookup(kind).m_arity;
+    } // end arity()
+
+    inline bool infix(const kind_type &kind) const
+    {
+      return lookup(kind).m_infix;
+    } // end infix()
+
+    // returns the instance of a nullary constructor, which is copied, not
+    // shared, by whatever stores it
+    inline const type &instance(const kind_type &kind) const
+    {
+      auto &c = lookup(kind);
+
+      if(c.m_arity != 0)
+      {
+        throw std::invalid_argument("constructor_registry::instance(): " + c.m_name + " is not nullary");
+      } // end if
+
+      return c.m_instance;
+    } // end instance()
+
+    // builds an application of kind to types, checking its arity
+    inline type make(const kind_type &kind,
+                     unification::type_vector &&types) const
+    {
+      auto &c = lookup(kind);
+
+      if(c.m_arity != types.size())
+      {
+        throw std::invalid_argument("constructor_registry::make(): wrong number of arguments to " + c.m_name);
+      } // end if
+
+      return c.m_arity ? type(type_operator(kind, std::move(types))) : c.m_instance;
+    } // end make()
+
+  private:
+    struct constructor
+    {
+      inline constructor(const std::string &name,
+                         const std::size_t arity,
+                         const bool infix,
+                         const type &instance)
+        : m_name(name),
+          m_arity(arity),
+          m_infix(infix),
+          m_instance(instance)
+      {}
+
+      std::string m_name;
+      std::size_t m_arity;
+      bool        m_infix;
+      type        m_instance;
+    }; // end constructor
+
+    inline const constructor &lookup(const kind_type &kind) const
+    {
+      if(!contains(kind))
+      {
+        throw std::out_of_range("constructor_registry: unknown kind");
+      } // end if
+
+      return m_constructors[kind];
+    } // end lookup()
+
+    // a deque so that references to canonical instances are never invalidated
+    std::deque<constructor> m_constructors;
+}; // end constructor_registry
+
+inline constructor_registry &constructors(void)
+{
+  static constructor_registry result;
+  return result;
 }
 
-inline type integer(void)
+inline type make_function(type arg,
+                          type result)
 {
-  return type_operator(types::integer);
+  unification::type_vector types;
+  types.reserve(2);
+  types.push_back(std::move(arg));
+  types.push_back(std::move(result));
+  return type_operator(types::function, std::move(types));
 }
 
-inline type boolean(void)
+inline const type &integer(void)
 {
-  return type_operator(types::boolean);
+  return constructors().instance(types::integer);
 }
 
-inline type pair(const type &first,
-                 const type &second)
+inline const type &boolean(void)
 {
-  return type_operator(types::pair, {first, second});
+  return constructors().instance(types::boolean);
 }
 
-inline type definitive(const std::map<type_variable,type> &substitution, const type_variable &x)
+inline type pair(type first,
+                 type second)
+{
+  unification::type_vector types;
+  types.reserve(2);
+  types.push_back(std::move(first));
+  types.push_back(std::move(second));
+  return type_operator(types::pair, std::move(types));
+}
+
+inline type definitive(const substitution_map &substitution, const type_variable &x)
 {
   type result = x;
  
@@ -88,8 +239,157 @@ inline type definitive(const std::map<type_variable,type> &substitution, const t
   return result;
 }
 
+using unification::resolve;
+
+// a type_table maps each node of a syntax tree to its type
+// nodes are identified by syntax::address(), so a table is valid only as long
+// as the tree it describes
+class type_table
+{
+  public:
+    typedef std::pair<const void*, type> entry;
+
+    inline void record(const syntax::node &n, const type &t)
+    {
+      m_entries.push_back(entry(syntax::address(n), t));
+    } // end record()
+
+    inline void record(const syntax::flat_node &n, const type &t)
+    {
+      m_entries.push_back(entry(n.address(), t));
+    } // end record()
+
+    // resolves every recorded type through the final substitution and
+    // sorts the table for lookup
+    inline void close(const substitution_map &substitution)
+    {
+      for(auto i = m_entries.begin();
+          i != m_entries.end();
+          ++i)
+      {
+        i->second = resolve(substitution, i->second);
+      } // end for i
+
+      std::sort(m_entries.begin(), m_entries.end(), compare_address());
+    } // end close()
+
+    // returns 0 if n was not recorded
+    inline const type *find(const syntax::node &n) const
+    {
+      return find(syntax::address(n));
+    } // end find()
+
+    inline const type *find(const syntax::flat_node &n) const
+    {
+      return find(n.address());
+    } // end find()
+
+    inline std::size_t size(void) const
+    {
+      return m_entries.size();
+    } // end size()
+
+    inline void clear(void)
+    {
+      m_entries.clear();
+    } // end clear()
+
+  private:
+    inline const type *find(const void *key) const
+    {
+      auto iter = std::lower_bound(m_entries.begin(), m_entries.end(), key, compare_address());
+      return (iter != m_entries.end() && iter->first == key) ? &iter->second : 0;
+    } // end find()
+
+    struct compare_address
+    {
+      inline bool operator()(const entry &x, const entry &y) const
+      {
+        return std::less<const void*>()(x.first, y.first);
+      }
+
+      inline bool operator()(const entry &x, const void *y) const
+      {
+        return std::less<const void*>()(x.first, y);
+      }
+    }; // end compare_address
+
+    std::vector<entry> m_entries;
+}; // end type_table
+
+// an instantiation_log records how each use of a generalized binding
+// instantiated the binding's type: the type each generic variable of the
+// binding was replaced with
+// uses are identified by syntax::address(), as in a type_table, and a use
+// whose binding has no generic variables is not recorded
+class instantiation_log
+{
+  public:
+    typedef std::vector<std::pair<type_variable, type>> instantiation;
+    typedef std::pair<const void*, instantiation> entry;
+
+    inline void record(const void *use, instantiation &&x)
+    {
+      m_entries.push_back(entry(use, std::move(x)));
+    } // end record()
+
+    // resolves every instantiation through the final substitution and sorts
+    // the log for lookup
+    inline void close(const substitution_map &substitution)
+    {
+      for(auto i = m_entries.begin();
+          i != m_entries.end();
+          ++i)
+      {
+        for(auto j = i->second.begin();
+            j != i->second.end();
+            ++j)
+        {
+          j->second = resolve(substitution, j->second);
+        } // end for j
+      } // end for i
+
+      std::sort(m_entries.begin(), m_entries.end(), compare_address());
+    } // end close()
+
+    // returns 0 if the use n was not recorded
+    inline const instantiation *find(const syntax::node &n) const
+    {
+      auto key = syntax::address(n);
+      auto iter = std::lower_bound(m_entries.begin(), m_entries.end(), key, compare_address());
+      return (iter != m_entries.end() && iter->first == key) ? &iter->second : 0;
+    } // end find()
+
+    inline std::size_t size(void) const
+    {
+      return m_entries.size();
+    } // end size()
+
+    inline void clear(void)
+    {
+      m_entries.clear();
+    } // end clear()
+
+  private:
+    struct compare_address
+    {
+      inline bool operator()(const entry &x, const entry &y) const
+      {
+        return std::less<const void*>()(x.first, y.first);
+      }
+
+      inline bool operator()(const entry &x, const void *y) const
+      {
+        return std::less<const void*>()(x.first, y);
+      }
+    }; // end compare_address
+
+    std::vector<entry> m_entries;
+}; // end instantiation_log
+
 class environment
-  : public std::map<std::string, type>
+  : public std::map<std::string, type, std::less<std::string>,
+                    unification::scratch_allocator<std::pair<const std::string, type>>>
 {
   public:
     inline environment()
@@ -101,47 +401,81 @@ class environment
       return m_next_id++;
     }
 
+    // subsequent calls to unique_id() begin from next
+    inline void reset_ids(const std::size_t next)
+    {
+      m_next_id = next;
+    }
+
+    inline std::size_t next_id() const
+    {
+      return m_next_id;
+    }
+
   private:
     std::size_t m_next_id;
 };
 
+// returns a stream which discards its output
+// each thread has its own, so that inferencers on different threads never share one
+inline std::ostream &null_log(void)
+{
+  static thread_local std::ostream result(0);
+  return result;
+}
+
 struct fresh_maker
   : boost::static_visitor<type>
 {
   inline fresh_maker(environment &env,
-                     const std::set<type_variable> &non_generic,
-                     const std::map<type_variable,type> &substitution)
+                     const variable_set &non_generic,
+                     const substitution_map &substitution,
+                     std::ostream &log = null_log(),
+                     unification::budget *b = 0)
     : m_env(env),
       m_non_generic(non_generic),
-      m_substitution(substitution)
+      m_substitution(substitution),
+      m_log(log),
+      m_budget(b),
+      m_encoded(false),
+      m_flat(false)
   {}
 
   inline result_type operator()(const type_variable &var)
   {
     if(is_generic(var))
     {
-      std::clog << var << " is generic" << std::endl;
-      std::clog << "mappings: " << m_mappings << std::endl;
+      m_log << var << " is generic" << std::endl;
+      m_log << "mappings: " << m_mappings << std::endl;
       if(!m_mappings.count(var))
       {
-        std::clog << var << " is not in mappings" << std::endl;
+        m_log << var << " is not in mappings" << std::endl;
         m_mappings[var] = type_variable(m_env.unique_id());
+        if(m_budget)
+        {
+          m_budget->charge(unification::budget::fresh_variables);
+        } // end if
       } // end if
 
       return m_mappings[var];
     } // end if
 
-    std::clog << var << " is not generic" << std::endl;
+    m_log << var << " is not generic" << std::endl;
 
     return var;
   } // end operator()()
 
   inline result_type operator()(const type_operator &op)
   {
-    std::vector<type> types(op.size());
+    if(m_budget)
+    {
+      m_budget->charge(unification::budget::type_nodes);
+    } // end if
+
+    unification::type_vector types(op.size());
     // make sure to pass a reference to this to maintain our state
     std::transform(op.begin(), op.end(), types.begin(), std::ref(*this));
-    return type_operator(op.kind(), types);
+    return type_operator(op.kind(), std::move(types));
   } // end operator()()
 
   inline result_type operator()(const type &x)
@@ -161,21 +495,54 @@ struct fresh_maker
     return result;
   } // end operator()
 
+  // appends to result the variable each generic variable met so far was
+  // replaced with
+  inline void instantiation(instantiation_log::instantiation &result) const
+  {
+    for(auto i = m_mappings.begin();
+        i != m_mappings.end();
+        ++i)
+    {
+      result.push_back(std::make_pair(i->first, type(i->second)));
+    } // end for i
+  } // end instantiation()
+
   private:
-    inline bool is_generic(const type_variable &var) const
+    inline bool is_generic(const type_variable &var)
     {
-      bool occurs = false;
+      m_log << "is_generic: checking for " << var << std::endl;
+
+      // the types of the non-generic variables are encoded once, on first use,
+      // and each later question is a scan of the encoding
+      if(!m_encoded)
+      {
+        m_encoded = true;
+        m_flat = true;
+        for(auto i = m_non_generic.begin();
+            m_flat && i != m_non_generic.end();
+            ++i)
+        {
+          m_flat = m_non_generic_types.append(*i, m_substitution);
+        } // end for i
+      } // end if
+
+      if(m_flat)
+      {
+        bool occurs = m_non_generic_types.contains(var);
+        m_log << "is_generic: occurs: " << occurs << std::endl;
+        return !occurs;
+      } // end if
 
-      std::clog << "is_generic: checking for " << var << std::endl;
+      bool occurs = false;
 
       for(auto i = m_non_generic.begin();
           i != m_non_generic.end();
           ++i)
       {
-        std::clog << "is_generic: checking in " << *i << std::endl;
-        occurs = unification::detail::occurs(definitive(m_substitution, *i), var);
+        m_log << "is_generic: checking in " << *i << std::endl;
+        occurs = unification::workspace::occurs(*i, var, m_substitution);
 
-        std::clog << "is_generic: occurs: " << occurs << std::endl;
+        m_log << "is_generic: occurs: " << occurs << std::endl;
 
         if(occurs) break;
       } // end for i
@@ -184,18 +551,200 @@ struct fresh_maker
     } // end is_generic()
 
     environment                           &m_env;
-    const std::set<type_variable>         &m_non_generic;
-    const std::map<type_variable,type>    &m_substitution;
-    std::map<type_variable, type_variable> m_mappings;
+    const variable_set                    &m_non_generic;
+    const substitution_map                &m_substitution;
+    std::map<type_variable, type_variable, std::less<type_variable>,
+             unification::scratch_allocator<std::pair<const type_variable, type_variable>>> m_mappings;
+    std::ostream                          &m_log;
+    unification::budget                   *m_budget;
+    bool                                   m_encoded;
+    bool                                   m_flat;
+    unification::flat_type                 m_non_generic_types;
 }; // end fresh_maker
 
+// a memo_cache remembers the principal types of closed terms by their
+// syntax::alpha_hash() so that a repeated closed term can be instantiated
+// instead of inferred again
+class memo_cache
+{
+  public:
+    struct counters
+    {
+      // the number of closed subterms hashed
+      std::size_t hashed;
+      std::size_t lookups;
+      std::size_t hits;
+      // the number of cached terms whose hash matched an inequivalent term
+      std::size_t collisions;
+    }; // end counters
+
+    inline memo_cache()
+      : m_counters()
+    {}
+
+    // prepares the cache to serve the subterms of root
+    inline void index(const syntax::node &root)
+    {
+      m_closed_subterms = syntax::closed_subterms(root);
+      m_counters.hashed += m_closed_subterms.size();
+    } // end index()
+
+    // returns true if n is a closed subterm of the indexed tree
+    inline bool closed(const syntax::node &n) const
+    {
+      return m_closed_subterms.count(syntax::address(n));
+    } // end closed()
+
+    // returns the cached type of n, or 0 if there is none
+    inline const type *find(const syntax::node &n)
+    {
+      auto hash = m_closed_subterms.find(syntax::address(n));
+      if(hash == m_closed_subterms.end())
+      {
+        return 0;
+      } // end if
+
+      ++m_counters.lookups;
+
+      auto range = m_types.equal_range(hash->second);
+      for(auto i = range.first;
+          i != range.second;
+          ++i)
+      {
+        if(syntax::alpha_equivalent(i->second.first, n))
+        {
+          ++m_counters.hits;
+          return &i->second.second;
+        } // end if
+
+        ++m_counters.collisions;
+      } // end for i
+
+      return 0;
+    } // end find()
+
+    // t must be the fully resolved type of the closed term n
+    inline void insert(const syntax::node &n, const type &t)
+    {
+      auto hash = m_closed_subterms.find(syntax::address(n));
+      if(hash != m_closed_subterms.end())
+      {
+        m_types.insert(std::make_pair(hash->second, std::make_pair(n, t)));
+      } // end if
+    } // end insert()
+
+    inline std::size_t size(void) const
+    {
+      return m_types.size();
+    } // end size()
+
+    inline const counters &statistics(void) const
+    {
+      return m_counters;
+    } // end statistics()
+
+  private:
+    std::unordered_map<const void*, std::size_t>                        m_closed_subterms;
+    std::unordered_multimap<std::size_t, std::pair<syntax::node, type>> m_types;
+    counters                                                            m_counters;
+}; // end memo_cache
+
 struct inferencer
   : boost::static_visitor<type>
 {
-  inline inferencer(const environment &env)
-    : m_environment(env)
+  inline inferencer(const environment &env,
+                    type_table *table = 0,
+                    memo_cache *memo = 0,
+                    unification::trace_writer *trace = 0,
+                    unification::budget *b = 0,
+                    profiler *p = 0)
+    : m_environment(env),
+      m_shared(0),
+      m_table(table),
+      m_memo(memo),
+      m_trace(trace),
+      m_budget(p ? &p->counters() : b),
+      m_workspace(m_budget),
+      m_profiler(p),
+      m_instantiations(0),
+      m_log(&null_log())
   {}
 
+  inline result_type operator()(const syntax::node &n)
+  {
+    if(m_budget)
+    {
+      m_budget->charge(unification::budget::steps);
+    } // end if
+
+    auto result = (m_memo && m_memo->closed(n)) ? memoized(n) : boost::apply_visitor(*this, n);
+
+    if(m_table)
+    {
+      m_table->record(n, result);
+    } // end if
+
+    return result;
+  } // end operator()()
+
+  // infers the type of a node of a flat_tree in place
+  // nodes of a flat_tree are recorded in the type_table but not memoized
+  inline result_type operator()(const syntax::flat_node &n)
+  {
+    if(m_budget)
+    {
+      m_budget->charge(unification::budget::steps);
+    } // end if
+
+    result_type result;
+
+    switch(n.kind())
+    {
+      case syntax::flat_node::integer_literal_kind:
+        result = integer();
+        break;
+
+      case syntax::flat_node::identifier_kind:
+        result = infer_identifier(n);
+        break;
+
+      case syntax::flat_node::apply_kind:
+        result = infer_apply(n);
+        break;
+
+      case syntax::flat_node::lambda_kind:
+        result = infer_lambda(n);
+        break;
+
+      case syntax::flat_node::let_kind:
+        result = infer_let(n);
+        break;
+
+      case syntax::flat_node::letrec_kind:
+        result = infer_letrec(n);
+        break;
+
+      case syntax::flat_node::letrec_group_kind:
+        result = infer_letrec_group(n.bindings(), n.components(), n.body());
+        break;
+
+      case syntax::flat_node::record_kind:
+        result = infer_record(n.fields());
+        break;
+
+      case syntax::flat_node::selection_kind:
+        result = infer_selection(n);
+        break;
+    } // end switch
+
+    if(m_table)
+    {
+      m_table->record(n, result);
+    } // end if
+
+    return result;
+  } // end operator()()
+
   inline result_type operator()(const syntax::integer_literal)
   {
     return integer();
@@ -203,86 +752,509 @@ struct inferencer
 
   inline result_type operator()(const syntax::identifier &id)
   {
-    if(!m_environment.count(id.name()))
+    return infer_identifier(id);
+  } // end operator()()
+
+  inline result_type operator()(const syntax::apply &app)
+  {
+    return infer_apply(app);
+  } // end operator()()
+
+  inline result_type operator()(const syntax::lambda &lambda)
+  {
+    return infer_lambda(lambda);
+  } // end operator()()
+
+  inline result_type operator()(const syntax::let &let)
+  {
+    return infer_let(let);
+  } // end operator()()
+
+  inline result_type operator()(const syntax::letrec &letrec)
+  {
+    return infer_letrec(letrec);
+  } // end operator()()
+
+  inline result_type operator()(const syntax::letrec_group &group)
+  {
+    auto graph = syntax::analyze_dependencies(group.bindings());
+    return infer_letrec_group(group.bindings(), graph.m_components, group.body());
+  } // end operator()()
+
+  inline result_type operator()(const syntax::record &r)
+  {
+    return infer_record(r.fields());
+  } // end operator()()
+
+  inline result_type operator()(const syntax::selection &s)
+  {
+    return infer_selection(s);
+  } // end operator()()
+
+  // reads env in place, beneath the bindings of this inferencer's own
+  // environment, rather than copying it. env must outlive the inferencer,
+  // which must have been constructed with an empty environment
+  inline void share(const environment &env)
+  {
+    m_shared = &env;
+    m_environment.reset_ids(env.next_id());
+  } // end share()
+
+  // returns the type bound to name, or 0 if there is none
+  inline const type *lookup(const std::string &name) const
+  {
+    auto iter = m_environment.find(name);
+    if(iter != m_environment.end())
+    {
+      return &iter->second;
+    } // end if
+
+    if(m_shared)
+    {
+      auto shared = m_shared->find(name);
+      if(shared != m_shared->end())
+      {
+        return &shared->second;
+      } // end if
+    } // end if
+
+    return 0;
+  } // end lookup()
+
+  // the rules below are templates so that they apply both to the classes of
+  // syntax::node and to syntax::flat_node, whose accessors mirror them
+
+  template<typename Identifier>
+    inline result_type infer_identifier(const Identifier &id)
+  {
+    auto bound = lookup(id.name());
+    if(!bound)
     {
       auto what = std::string("Undefined symbol ") + id.name();
       throw std::runtime_error(what);
     } // end if
 
     // create a fresh type
-    std::clog << "inferencer(identifier): m_non_generic_variables: " << m_non_generic_variables << std::endl;
-    std::clog << "inferencer(identifier): calling fresh_maker on " << id.name() << std::endl;
-    auto freshen_me = m_environment[id.name()];
-    auto v = fresh_maker(m_environment, m_non_generic_variables, m_substitution);
-    return v(freshen_me);
-  } // end operator()()
+    (*m_log) << "inferencer(identifier): m_non_generic_variables: " << m_non_generic_variables << std::endl;
+    (*m_log) << "inferencer(identifier): calling fresh_maker on " << id.name() << std::endl;
+    profiler::scope frame(m_profiler);
+    if(m_profiler)
+    {
+      frame.enter("use", id.name());
+    } // end if
 
-  inline result_type operator()(const syntax::apply &app)
+    auto freshen_me = *bound;
+    auto v = fresh_maker(m_environment, m_non_generic_variables, m_substitution, *m_log, m_budget);
+    auto result = v(freshen_me);
+
+    if(m_instantiations)
+    {
+      instantiation_log::instantiation x;
+      v.instantiation(x);
+      if(!x.empty())
+      {
+        m_instantiations->record(address(id), std::move(x));
+      } // end if
+    } // end if
+
+    return result;
+  } // end infer_identifier()
+
+  inline static const void *address(const syntax::identifier &id)
+  {
+    return &id;
+  } // end address()
+
+  inline static const void *address(const syntax::flat_node &n)
   {
-    std::clog << "inferencer(apply): m_non_generic_variables: " << std::endl;
-    std::clog << m_non_generic_variables << std::endl;
+    return n.address();
+  } // end address()
 
-    auto fun_type = boost::apply_visitor(*this, app.function());
-    auto arg_type = boost::apply_visitor(*this, app.argument());
+  template<typename Apply>
+    inline result_type infer_apply(const Apply &app)
+  {
+    (*m_log) << "inferencer(apply): m_non_generic_variables: " << std::endl;
+    (*m_log) << m_non_generic_variables << std::endl;
 
-    std::clog << "inferencer(apply): calling unique_id" << std::endl;
-    auto x = type_variable(m_environment.unique_id());
+    auto fun_type = (*this)(app.function());
+    auto arg_type = (*this)(app.argument());
+
+    (*m_log) << "inferencer(apply): calling unique_id" << std::endl;
+    auto x = fresh_variable();
     auto lhs = make_function(arg_type, x);
+    if(m_budget)
+    {
+      m_budget->charge(unification::budget::type_nodes);
+    } // end if
 
-    unification::unify(lhs, fun_type, m_substitution);
+    unify(lhs, fun_type);
 
     return definitive(m_substitution,x);
-  } // end operator()()
+  } // end infer_apply()
 
-  inline result_type operator()(const syntax::lambda &lambda)
+  template<typename Lambda>
+    inline result_type infer_lambda(const Lambda &lambda)
   {
-    std::clog << "inferencer(lambda): calling unique_id" << std::endl;
-    auto arg_type = type_variable(m_environment.unique_id());
+    (*m_log) << "inferencer(lambda): calling unique_id" << std::endl;
+    auto arg_type = fresh_variable();
 
     // introduce a scope with a non-generic variable
     auto s = scoped_non_generic_variable(this, lambda.parameter(), arg_type);
 
     // get the type of the body of the lambda
-    std::clog << "inferencer(lambda): m_non_generic_variables: " << m_non_generic_variables << std::endl;
-    auto body_type = boost::apply_visitor(*this, lambda.body());
+    (*m_log) << "inferencer(lambda): m_non_generic_variables: " << m_non_generic_variables << std::endl;
+    auto body_type = (*this)(lambda.body());
 
     // x = (arg_type -> body_type)
-    std::clog << "inferencer(lambda): calling unique_id" << std::endl;
-    auto x = type_variable(m_environment.unique_id());
-    unification::unify(x, make_function(arg_type, body_type), m_substitution);
+    (*m_log) << "inferencer(lambda): calling unique_id" << std::endl;
+    auto x = fresh_variable();
+    if(m_budget)
+    {
+      m_budget->charge(unification::budget::type_nodes);
+    } // end if
+    unify(x, make_function(arg_type, body_type));
 
     return definitive(m_substitution,x);
-  } // end operator()()
+  } // end infer_lambda()
 
-  inline result_type operator()(const syntax::let &let)
+  template<typename Let>
+    inline result_type infer_let(const Let &let)
   {
-    auto defn_type = boost::apply_visitor(*this, let.definition());
+    type defn_type;
+    {
+      profiler::scope frame(m_profiler);
+      if(m_profiler)
+      {
+        frame.enter("let", let.name());
+      } // end if
+
+      defn_type = (*this)(let.definition());
+    }
 
     // introduce a scope with a generic variable
     auto s = scoped_generic(this, let.name(), defn_type);
 
-    auto result = boost::apply_visitor(*this, let.body());
+    auto result = (*this)(let.body());
 
     return result;
-  } // end operator()()
+  } // end infer_let()
 
-  inline result_type operator()(const syntax::letrec &letrec)
+  template<typename Letrec>
+    inline result_type infer_letrec(const Letrec &letrec)
   {
-    std::clog << "inferencer(letrec): calling unique_id" << std::endl;
-    auto new_type = type_variable(m_environment.unique_id());
+    (*m_log) << "inferencer(letrec): calling unique_id" << std::endl;
+    auto new_type = fresh_variable();
 
     // introduce a scope with a non generic variable
     auto s = scoped_non_generic_variable(this, letrec.name(), new_type);
 
-    auto definition_type = boost::apply_visitor(*this, letrec.definition());
+    {
+      profiler::scope frame(m_profiler);
+      if(m_profiler)
+      {
+        frame.enter("letrec", letrec.name());
+      } // end if
 
-    // new_type = definition_type
-    unification::unify(new_type, definition_type, m_substitution);
+      auto definition_type = (*this)(letrec.definition());
 
-    auto result = boost::apply_visitor(*this, letrec.body());
+      // new_type = definition_type
+      unify(new_type, definition_type);
+    }
+
+    auto result = (*this)(letrec.body());
 
     return result;
-  }
+  } // end infer_letrec()
+
+  // components are the strongly connected components of bindings in
+  // topological order
+  template<typename Bindings, typename Body>
+    inline result_type infer_letrec_group(const Bindings &bindings,
+                                          const std::vector<std::vector<std::size_t>> &components,
+                                          const Body &body)
+  {
+    // the members of each component are generalized before the components
+    // which depend on them are inferred
+    std::vector<std::unique_ptr<scoped_generic>> generic;
+
+    for(auto component = components.begin();
+        component != components.end();
+        ++component)
+    {
+      auto types = infer_component(bindings, *component);
+
+      for(std::size_t i = 0; i < component->size(); ++i)
+      {
+        generic.emplace_back(new scoped_generic(this, bindings[(*component)[i]].first, types[i]));
+      } // end for i
+    } // end for component
+
+    return (*this)(body);
+  } // end infer_letrec_group()
+
+  // infers the definitions of the given members of bindings as one mutually
+  // recursive component, during which each member is non-generic
+  // returns the type of each member, which the caller may generalize
+  template<typename Bindings>
+    inline std::vector<type_variable> infer_component(const Bindings &bindings,
+                                                      const std::vector<std::size_t> &members)
+  {
+    std::vector<type_variable> result;
+    std::vector<std::unique_ptr<scoped_non_generic_variable>> scopes;
+
+    for(auto i = members.begin(); i != members.end(); ++i)
+    {
+      (*m_log) << "inferencer(letrec_group): calling unique_id" << std::endl;
+      result.push_back(fresh_variable());
+      scopes.emplace_back(new scoped_non_generic_variable(this, bindings[*i].first, result.back()));
+    } // end for i
+
+    for(std::size_t i = 0; i < members.size(); ++i)
+    {
+      profiler::scope frame(m_profiler);
+      if(m_profiler)
+      {
+        frame.enter("letrec", bindings[members[i]].first);
+      } // end if
+
+      auto definition_type = (*this)(bindings[members[i]].second);
+      unify(result[i], definition_type);
+    } // end for i
+
+    return result;
+  } // end infer_component()
+
+  // a record's type is closed: it has exactly the fields written
+  template<typename Fields>
+    inline result_type infer_record(const Fields &fields)
+  {
+    unification::field_vector types;
+    types.reserve(fields.size());
+
+    for(std::size_t i = 0; i < fields.size(); ++i)
+    {
+      auto &&f = fields[i];
+      auto field_type = (*this)(f.second);
+      types.push_back(unification::field(unification::rows().intern(f.first), field_type));
+    } // end for i
+
+    std::stable_sort(types.begin(), types.end(), unification::detail::by_label);
+
+    auto duplicate = std::adjacent_find(types.begin(), types.end(), [](const unification::field &x, const unification::field &y)
+    {
+      return x.first == y.first;
+    });
+
+    if(duplicate != types.end())
+    {
+      throw std::runtime_error("record has field " + unification::rows().name(duplicate->first) + " more than once");
+    } // end if
+
+    if(m_budget)
+    {
+      m_budget->charge(unification::budget::type_nodes, types.size() + 1);
+    } // end if
+
+    return unification::make_record(types, unification::empty_row());
+  } // end infer_record()
+
+  // r.l requires only that r have a field l: r : {l : a | rest}
+  template<typename Selection>
+    inline result_type infer_selection(const Selection &s)
+  {
+    auto record_type = (*this)(s.record());
+
+    auto field_type = fresh_variable();
+    auto rest = fresh_variable();
+
+    unification::field_vector fields;
+    fields.push_back(unification::field(unification::rows().intern(s.label()), field_type));
+    if(m_budget)
+    {
+      m_budget->charge(unification::budget::type_nodes, 2);
+    } // end if
+
+    unify(unification::make_record(fields, rest), record_type);
+
+    return definitive(m_substitution, field_type);
+  } // end infer_selection()
+
+  inline type_variable fresh_variable(void)
+  {
+    if(m_budget)
+    {
+      m_budget->charge(unification::budget::fresh_variables);
+    } // end if
+
+    return type_variable(m_environment.unique_id());
+  } // end fresh_variable()
+
+  inline void unify(const type &x, const type &y)
+  {
+    if(m_trace)
+    {
+      m_trace->record(x, y);
+    } // end if
+
+    m_workspace.unify(x, y, m_substitution, [this]{ return fresh_variable(); });
+  } // end unify()
+
+  // bounds the growth of the substitution across a long session
+  //
+  // resolves the types of the environment through the substitution and then
+  // discards every binding which is not reachable from the non-generic
+  // variables. if renumber is true, the variables which remain are renamed
+  // densely from 0 and unique ids continue after them
+  //
+  // compact() must not be called while a scope is open, and types obtained
+  // before renumbering refer to the old names of variables
+  inline void compact(const bool renumber = false)
+  {
+    for(auto i = m_environment.begin();
+        i != m_environment.end();
+        ++i)
+    {
+      i->second = resolve(m_substitution, i->second);
+    } // end for i
+
+    collect(renumber);
+  } // end compact()
+
+  // as above, but resolves only the types bound to names, which must be the
+  // only types of the environment which may mention bound variables, so that
+  // a session which compacts after every inference needn't resolve the whole
+  // environment each time
+  template<typename Range>
+    inline void compact(const Range &names, const bool renumber = false)
+  {
+    for(auto name = names.begin();
+        name != names.end();
+        ++name)
+    {
+      auto i = m_environment.find(*name);
+      if(i != m_environment.end())
+      {
+        i->second = resolve(m_substitution, i->second);
+      } // end if
+    } // end for name
+
+    collect(renumber);
+  } // end compact()
+
+  // discards the bindings of the substitution which are not reachable from
+  // the non-generic variables, and renumbers variables if asked
+  inline void collect(const bool renumber)
+  {
+    substitution_map live;
+    std::vector<type_variable> reachable(m_non_generic_variables.begin(), m_non_generic_variables.end());
+    while(!reachable.empty())
+    {
+      auto var = reachable.back();
+      reachable.pop_back();
+
+      auto iter = m_substitution.find(var);
+      if(iter != m_substitution.end() && live.insert(*iter).second)
+      {
+        variables(iter->second, reachable);
+      } // end if
+    } // end while
+
+    m_substitution.swap(live);
+
+    if(renumber)
+    {
+      std::map<type_variable,type_variable> names;
+
+      for(auto i = m_environment.begin();
+          i != m_environment.end();
+          ++i)
+      {
+        rename(i->second, names);
+      } // end for i
+
+      variable_set non_generic;
+      for(auto i = m_non_generic_variables.begin();
+          i != m_non_generic_variables.end();
+          ++i)
+      {
+        type var = *i;
+        rename(var, names);
+        non_generic.insert(boost::get<type_variable>(var));
+      } // end for i
+      m_non_generic_variables.swap(non_generic);
+
+      substitution_map substitution;
+      for(auto i = m_substitution.begin();
+          i != m_substitution.end();
+          ++i)
+      {
+        type var = i->first;
+        rename(var, names);
+        rename(i->second, names);
+        substitution[boost::get<type_variable>(var)] = std::move(i->second);
+      } // end for i
+      m_substitution.swap(substitution);
+
+      m_environment.reset_ids(names.size());
+    } // end if
+  } // end collect()
+
+  // appends the variables of x to result
+  inline static void variables(const type &x, std::vector<type_variable> &result)
+  {
+    if(auto var = boost::get<type_variable>(&x))
+    {
+      result.push_back(*var);
+    } // end if
+    else
+    {
+      auto &op = boost::get<type_operator>(x);
+      for(auto i = op.begin();
+          i != op.end();
+          ++i)
+      {
+        variables(*i, result);
+      } // end for i
+    } // end else
+  } // end variables()
+
+  // renames the variables of x in order of first appearance across calls
+  inline static void rename(type &x, std::map<type_variable,type_variable> &names)
+  {
+    if(auto var = boost::get<type_variable>(&x))
+    {
+      auto iter = names.find(*var);
+      if(iter == names.end())
+      {
+        iter = names.insert(std::make_pair(*var, type_variable(names.size()))).first;
+      } // end if
+
+      *var = iter->second;
+    } // end if
+    else
+    {
+      auto &op = boost::get<type_operator>(x);
+      for(std::size_t i = 0; i < op.size(); ++i)
+      {
+        rename(op[i], names);
+      } // end for i
+    } // end else
+  } // end rename()
+
+  inline result_type memoized(const syntax::node &n)
+  {
+    if(auto t = m_memo->find(n))
+    {
+      // every variable in the type of a closed term is generic
+      variable_set non_generic;
+      substitution_map substitution;
+      return fresh_maker(m_environment, non_generic, substitution, *m_log, m_budget)(*t);
+    } // end if
+
+    auto result = boost::apply_visitor(*this, n);
+    m_memo->insert(n, resolve(m_substitution, result));
+    return result;
+  } // end memoized()
 
   struct scoped_generic
   {
@@ -348,24 +1320,166 @@ struct inferencer
       } // end if
     } // end ~scoped_non_generic_variable()
 
-    std::set<type_variable>                           &m_non_generic;
-    std::pair<std::set<type_variable>::iterator, bool> m_erase_me;
+    variable_set                           &m_non_generic;
+    std::pair<variable_set::iterator, bool> m_erase_me;
   };
 
   environment                         m_environment;
-  std::set<type_variable>             m_non_generic_variables;
-  std::map<type_variable,type>        m_substitution;
+  // read beneath m_environment, if not null
+  const environment                  *m_shared;
+  variable_set                        m_non_generic_variables;
+  // triangular; resolve() a type through it before it leaves the inferencer
+  substitution_map                    m_substitution;
+  type_table                         *m_table;
+  memo_cache                         *m_memo;
+  unification::trace_writer          *m_trace;
+  unification::budget                *m_budget;
+  unification::workspace              m_workspace;
+  // null unless profiling
+  profiler                           *m_profiler;
+  // null unless recording instantiations
+  instantiation_log                  *m_instantiations;
+  // debugging output; discarded unless redirected
+  std::ostream                       *m_log;
 };
 
 type infer_type(const syntax::node &node,
                 const environment &env)
 {
   auto v = inferencer(env);
-  auto old = std::clog.rdbuf(0);
-  auto result = boost::apply_visitor(v, node);
-  std::clog.rdbuf(old);
+  return resolve(v.m_substitution, v(node));
+}
+
+// as above, but also records the type of every node of the tree in table
+type infer_type(const syntax::node &node,
+                const environment &env,
+                type_table &table)
+{
+  table.clear();
+  auto v = inferencer(env, &table);
+  auto result = resolve(v.m_substitution, v(node));
+  table.close(v.m_substitution);
   return result;
 }
 
-} // end inference
+// as above, but also records in log how each use of a generalized binding
+// instantiated it
+type infer_type(const syntax::node &node,
+                const environment &env,
+                type_table &table,
+                instantiation_log &log)
+{
+  table.clear();
+  log.clear();
+  auto v = inferencer(env, &table);
+  v.m_instantiations = &log;
+  auto result = resolve(v.m_substitution, v(node));
+  table.close(v.m_substitution);
+  log.close(v.m_substitution);
+  return result;
+}
+
+// as above, but instantiates repeated closed terms from memo
+// nodes within a term instantiated from memo are not visited
+type infer_type(const syntax::node &node,
+                const environment &env,
+                memo_cache &memo)
+{
+  memo.index(node);
+  auto v = inferencer(env, 0, &memo);
+  return resolve(v.m_substitution, v(node));
+}
+
+// as above, but records the constraints of every call to unify() in trace
+type infer_type(const syntax::node &node,
+                const environment &env,
+                unification::trace_writer &trace)
+{
+  trace.begin();
+  auto v = inferencer(env, 0, 0, &trace);
+  return resolve(v.m_substitution, v(node));
+}
+
+// the result of an inference charged to a budget
+// a program whose inference runs out of budget is neither well nor ill typed,
+// so running out is a result rather than an error
+struct budgeted_type
+{
+  inline budgeted_type()
+    : m_exhausted(false)
+  {}
+
+  inline explicit operator bool(void) const
+  {
+    return !m_exhausted;
+  }
+
+  bool         m_exhausted;
+  // the type, if the budget sufficed
+  type         m_type;
+  // which limit ran out, if one did, as budget_exhausted::reason
+  std::string  m_reason;
+};
+
+// as above, but charges the work of inference to b, and reads env in place
+// rather than copying it, so that many threads may share one environment
+// returns a result marked exhausted if b runs out. type errors are thrown, as
+// by the other overloads
+// the unifier and the inferencer still unwind with budget_exhausted once b
+// runs out, since they charge it from deep recursion, but the exception
+// never escapes this function
+budgeted_type infer_type(const syntax::node &node,
+                         const environment &env,
+                         unification::budget &b)
+{
+  budgeted_type result;
+
+  try
+  {
+    environment local;
+    auto v = inferencer(local, 0, 0, 0, &b);
+    v.share(env);
+    result.m_type = resolve(v.m_substitution, v(node));
+  } // end try
+  catch(const unification::budget_exhausted &e)
+  {
+    result.m_exhausted = true;
+    result.m_reason = e.reason;
+  } // end catch
+
+  return result;
+}
+
+// as above, but allocates the scratch memory of inference, including the
+// copy of env, from resource, which may be released as soon as infer_type
+// returns
+type infer_type(const syntax::node &node,
+                const environment &env,
+                std::pmr::memory_resource &resource)
+{
+  return unification::with_resource(resource, [&]
+  {
+    auto v = inferencer(env);
+    return resolve(v.m_substitution, v(node));
+  });
+}
+
+// as above, but attributes the cost of inference to the bindings and
+// identifier uses of node in p
+type infer_type(const syntax::node &node,
+                const environment &env,
+                profiler &p)
+{
+  auto v = inferencer(env, 0, 0, 0, 0, &p);
+  return resolve(v.m_substitution, v(node));
+}
 
+// as above, but for a tree encoded by syntax::flatten(), which is traversed in place
+type infer_type(const syntax::flat_tree &tree,
+                const environment &env)
+{
+  auto v = inferencer(env);
+  return resolve(v.m_substitution, v(tree.root()));
+}
+
+} // end inference
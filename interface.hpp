@@ -0,0 +1,323 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <atomic>
+#include <unistd.h>
+#include "unification.hpp"
+#include "syntax.hpp"
+#include "dependencies.hpp"
+#include "trace.hpp"
+#include "inference.hpp"
+#include "module.hpp"
+
+namespace inference
+{
+
+// a module_interface records the generalized type of each of a module's
+// definitions, so that a module which hasn't changed need not be inferred
+// again
+//
+// the variables of each type are numbered from 0 in order of first appearance.
+// an interface file is the magic string "hmiface3" followed by
+//
+//   varint(key) varint(number of exports) (varint(length) name type)*
+//
+// where types and varints are encoded as in trace.hpp
+struct module_interface
+{
+  std::uint64_t                                  m_key;
+  std::vector<std::pair<std::string, type>>      m_exports;
+};
+
+namespace detail
+{
+
+// 64-bit FNV-1a, which unlike std::hash is the same in every build
+class content_hasher
+{
+  public:
+    inline content_hasher()
+      : m_state(14695981039346656037ull)
+    {}
+
+    inline void operator()(const std::string &s)
+    {
+      for(auto i = s.begin(); i != s.end(); ++i)
+      {
+        m_state ^= static_cast<unsigned char>(*i);
+        m_state *= 1099511628211ull;
+      } // end for i
+
+      // separate consecutive strings
+      m_state ^= 0xff;
+      m_state *= 1099511628211ull;
+    } // end operator()()
+
+    inline std::uint64_t value(void) const
+    {
+      return m_state;
+    } // end value()
+
+  private:
+    std::uint64_t m_state;
+}; // end content_hasher
+
+// renames the variables of x to 0, 1, 2, ... in order of first appearance
+inline type canonical(const type &x)
+{
+  type result = x;
+  std::map<type_variable,type_variable> names;
+  inferencer::rename(result, names);
+  return result;
+} // end canonical()
+
+// renames the variables of a canonical type to first_id, first_id + 1, ...
+// returns one more than the largest canonical variable of x
+inline std::size_t offset_variables(type &x, const std::size_t first_id)
+{
+  if(auto var = boost::get<type_variable>(&x))
+  {
+    std::size_t id = var->id();
+    *var = type_variable(first_id + id);
+    return id + 1;
+  } // end if
+
+  std::size_t result = 0;
+  auto &op = boost::get<type_operator>(x);
+  for(std::size_t i = 0; i < op.size(); ++i)
+  {
+    result = std::max(result, offset_variables(op[i], first_id));
+  } // end for i
+
+  return result;
+} // end offset_variables()
+
+// returns true if each type_operator of x is a record, or a constructor
+// declared with the arity x gives it
+inline bool well_formed(const type &x)
+{
+  if(boost::get<type_variable>(&x))
+  {
+    return true;
+  } // end if
+
+  auto &op = boost::get<type_operator>(x);
+  if(!unification::is_record(op) &&
+     (!constructors().contains(op.kind()) || constructors().arity(op.kind()) != op.size()))
+  {
+    return false;
+  } // end if
+
+  for(auto i = op.begin();
+      i != op.end();
+      ++i)
+  {
+    if(!well_formed(*i)) return false;
+  } // end for i
+
+  return true;
+} // end well_formed()
+
+// returns a name for a temporary file beside path which no other process,
+// nor any other thread of this one, is using
+inline std::string temporary_name(const std::string &path)
+{
+  static std::atomic<std::size_t> counter(0);
+  return path + ".tmp." + std::to_string(::getpid()) + "." + std::to_string(counter++);
+} // end temporary_name()
+
+inline std::string encode(const type &x)
+{
+  std::ostringstream os;
+  unification::write_type(os, x);
+  return os.str();
+} // end encode()
+
+} // end detail
+
+// returns the key of a module's interface, a hash of everything its types
+// depend on: its definitions, the types of the names it imports from env, and
+// the constructors declared so far
+inline std::uint64_t interface_key(const std::vector<syntax::letrec_group::binding> &definitions,
+                                   const environment &env)
+{
+  detail::content_hasher hash;
+  hash("hmiface3");
+
+  for(std::size_t kind = 0; constructors().contains(kind); ++kind)
+  {
+    hash(constructors().name(kind));
+    hash(std::to_string(constructors().arity(kind)));
+  } // end for kind
+
+  std::set<std::string> defined, imported;
+  for(auto i = definitions.begin(); i != definitions.end(); ++i)
+  {
+    defined.insert(i->first);
+  } // end for i
+
+  for(auto i = definitions.begin(); i != definitions.end(); ++i)
+  {
+    std::ostringstream os;
+    os << i->second;
+    hash(i->first);
+    hash(os.str());
+
+    auto free = syntax::free_identifiers(i->second);
+    for(auto name = free.begin(); name != free.end(); ++name)
+    {
+      if(!defined.count(*name)) imported.insert(*name);
+    } // end for name
+  } // end for i
+
+  for(auto name = imported.begin(); name != imported.end(); ++name)
+  {
+    hash(*name);
+
+    auto iter = env.find(*name);
+    hash(iter == env.end() ? std::string() : detail::encode(detail::canonical(iter->second)));
+  } // end for name
+
+  return hash.value();
+} // end interface_key()
+
+inline void write_interface(std::ostream &os, const module_interface &iface)
+{
+  os.write("hmiface3", 8);
+  unification::detail::write_varint(os, iface.m_key);
+  unification::detail::write_varint(os, iface.m_exports.size());
+
+  for(auto i = iface.m_exports.begin();
+      i != iface.m_exports.end();
+      ++i)
+  {
+    unification::detail::write_varint(os, i->first.size());
+    os.write(i->first.data(), i->first.size());
+    unification::write_type(os, detail::canonical(i->second));
+  } // end for i
+} // end write_interface()
+
+// throws unification::bad_trace if is does not hold an interface
+// no count read from is is trusted beyond the bytes left in it, and each
+// type must be well formed against the constructors declared so far
+inline module_interface read_interface(std::istream &is)
+{
+  char magic[8];
+  if(!is.read(magic, 8) || std::string(magic, 8) != "hmiface3")
+  {
+    throw unification::bad_trace("missing interface magic");
+  } // end if
+
+  module_interface result;
+  result.m_key = unification::detail::read_varint(is);
+  result.m_exports.resize(unification::detail::read_count(is));
+
+  for(auto i = result.m_exports.begin();
+      i != result.m_exports.end();
+      ++i)
+  {
+    i->first.resize(unification::detail::read_count(is));
+    if(!is.read(&i->first[0], i->first.size()))
+    {
+      throw unification::bad_trace("unexpected end of file");
+    } // end if
+
+    i->second = unification::read_type(is);
+    if(!detail::well_formed(i->second) || !(detail::canonical(i->second) == i->second))
+    {
+      throw unification::bad_trace("bad type in interface");
+    } // end if
+  } // end for i
+
+  return result;
+} // end read_interface()
+
+// brings a module's definitions into env
+//
+// if the interface file at path was written for the same key, the types of
+// the definitions are loaded from it; otherwise the module is inferred with
+// check_module() and its interface is written to path. a missing or damaged
+// interface file is simply replaced
+//
+// the variables of the types added to env are renamed with env's unique ids,
+// so that they never collide with variables of later inferences
+// returns true if the interface was loaded from path
+inline bool import_module(const std::vector<syntax::letrec_group::binding> &definitions,
+                          environment &env,
+                          const std::string &path,
+                          const std::size_t num_threads = std::thread::hardware_concurrency())
+{
+  module_interface iface;
+  iface.m_key = interface_key(definitions, env);
+
+  bool cached = false;
+
+  std::ifstream is(path.c_str(), std::ios::binary);
+  if(is)
+  {
+    try
+    {
+      auto stored = read_interface(is);
+      cached = stored.m_key == iface.m_key && stored.m_exports.size() == definitions.size();
+      for(std::size_t i = 0; cached && i < definitions.size(); ++i)
+      {
+        cached = stored.m_exports[i].first == definitions[i].first;
+      } // end for i
+
+      if(cached)
+      {
+        iface = std::move(stored);
+      } // end if
+    } // end try
+    catch(const std::exception &)
+    {
+      // whatever was wrong with the file, it's a miss
+      cached = false;
+    } // end catch
+  } // end if
+
+  if(!cached)
+  {
+    auto types = check_module(definitions, env, num_threads);
+    for(std::size_t i = 0; i < definitions.size(); ++i)
+    {
+      iface.m_exports.push_back(std::make_pair(definitions[i].first, detail::canonical(types[i])));
+    } // end for i
+
+    // write to a temporary of our own and rename it, so that a reader never
+    // sees half a file and concurrent writers never share one
+    // the interface is only a cache, so if it can't be written it's dropped
+    std::string temporary = detail::temporary_name(path);
+    std::ofstream os(temporary.c_str(), std::ios::binary | std::ios::trunc);
+    write_interface(os, iface);
+    os.close();
+    if(!os || std::rename(temporary.c_str(), path.c_str()) != 0)
+    {
+      std::remove(temporary.c_str());
+    } // end if
+  } // end if
+
+  for(auto i = iface.m_exports.begin();
+      i != iface.m_exports.end();
+      ++i)
+  {
+    type t = i->second;
+
+    std::size_t first_id = env.unique_id();
+    std::size_t num_variables = detail::offset_variables(t, first_id);
+    env.reset_ids(first_id + std::max<std::size_t>(num_variables, 1));
+
+    env[i->first] = t;
+  } // end for i
+
+  return cached;
+} // end import_module()
+
+} // end inference
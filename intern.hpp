@@ -0,0 +1,334 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <boost/functional/hash.hpp>
+#include "unification.hpp"
+
+namespace unification
+{
+
+// a type_interner keeps one canonical, immutable copy of each distinct type
+// given to it, so that threads which build equal types, such as the schemes
+// of a module's definitions or the int -> int of every arithmetic function,
+// hold one shared copy rather than a copy each
+//
+// an interned type is a handle, a pointer to a node whose children are
+// themselves handles. two handles from the same interner are equal exactly
+// when their types are equal, and a type is stored once however many types
+// it appears in
+//
+// intern() is lock-free. each bucket is a chain of nodes which only ever
+// grows at its head by compare-and-swap, and nodes are never moved or freed
+// before the interner is destroyed, so readers never wait for writers. the
+// number of buckets is fixed, so chains lengthen once the interner holds many
+// more types than it has buckets. each thread also remembers the nodes it
+// interned recently, so that a thread rebuilding the same few shapes finds
+// them without touching the shared buckets at all
+class type_interner
+{
+  public:
+    class node
+    {
+      public:
+        inline bool is_variable(void) const
+        {
+          return m_is_variable;
+        } // end is_variable()
+
+        // the variable's id or the operator's kind
+        inline std::size_t label(void) const
+        {
+          return m_label;
+        } // end label()
+
+        inline std::size_t size(void) const
+        {
+          return m_size;
+        } // end size()
+
+        inline const node *operator[](const std::size_t i) const
+        {
+          return children()[i];
+        } // end operator[]()
+
+        inline std::size_t hash(void) const
+        {
+          return m_hash;
+        } // end hash()
+
+      private:
+        friend class type_interner;
+
+        inline node(const bool is_variable, const std::size_t label, const std::size_t size, const std::size_t hash)
+          : m_is_variable(is_variable),
+            m_label(label),
+            m_size(size),
+            m_hash(hash),
+            m_next(0)
+        {}
+
+        inline const node **children(void)
+        {
+          return reinterpret_cast<const node**>(this + 1);
+        } // end children()
+
+        inline const node *const *children(void) const
+        {
+          return reinterpret_cast<const node *const *>(this + 1);
+        } // end children()
+
+        inline bool matches(const bool is_variable, const std::size_t label, const node *const *children, const std::size_t size) const
+        {
+          return m_is_variable == is_variable && m_label == label && m_size == size && std::equal(children, children + size, this->children());
+        } // end matches()
+
+        bool         m_is_variable;
+        std::size_t  m_label;
+        std::size_t  m_size;
+        std::size_t  m_hash;
+        // the next node of the bucket, which never changes once published
+        const node  *m_next;
+        // followed by m_size children
+    }; // end node
+
+    typedef const node *handle;
+
+    inline type_interner(const std::size_t num_buckets = std::size_t(1) << 16)
+      : m_mask(round_up(num_buckets) - 1),
+        m_buckets(new std::atomic<const node*>[m_mask + 1]),
+        m_serial(next_serial()++),
+        m_size(0),
+        m_bytes(0)
+    {
+      for(std::size_t i = 0; i <= m_mask; ++i)
+      {
+        m_buckets[i].store(0, std::memory_order_relaxed);
+      } // end for i
+    } // end type_interner()
+
+    inline ~type_interner()
+    {
+      for(std::size_t i = 0; i <= m_mask; ++i)
+      {
+        for(const node *n = m_buckets[i].load(std::memory_order_relaxed); n;)
+        {
+          const node *next = n->m_next;
+          deallocate(n);
+          n = next;
+        } // end for n
+      } // end for i
+    } // end ~type_interner()
+
+    // returns the canonical copy of x
+    inline handle intern(const type &x)
+    {
+      if(auto var = boost::get<type_variable>(&x))
+      {
+        return variable(var->id());
+      } // end if
+
+      auto &op = boost::get<type_operator>(x);
+
+      // most types are small, so their children needn't go to the heap
+      const std::size_t small = 4;
+      handle local[small];
+      std::vector<handle> heap;
+      handle *children = local;
+      if(op.size() > small)
+      {
+        heap.resize(op.size());
+        children = heap.data();
+      } // end if
+
+      for(std::size_t i = 0; i < op.size(); ++i)
+      {
+        children[i] = intern(op[i]);
+      } // end for i
+
+      return make(op.kind(), children, op.size());
+    } // end intern()
+
+    inline handle variable(const std::size_t id)
+    {
+      return insert(true, id, 0, 0);
+    } // end variable()
+
+    // returns the canonical operator of kind applied to the given children,
+    // which must have come from this interner
+    inline handle make(const type_operator::kind_type kind, const handle *children, const std::size_t size)
+    {
+      return insert(false, kind, children, size);
+    } // end make()
+
+    // returns a type equal to the interned type, allocated from the current
+    // resource
+    inline static type extract(const handle x)
+    {
+      if(x->is_variable())
+      {
+        return type_variable(x->label());
+      } // end if
+
+      type_vector children;
+      children.reserve(x->size());
+      for(std::size_t i = 0; i < x->size(); ++i)
+      {
+        children.push_back(extract((*x)[i]));
+      } // end for i
+
+      return type_operator(x->label(), std::move(children));
+    } // end extract()
+
+    // returns the number of distinct types interned
+    inline std::size_t size(void) const
+    {
+      return m_size.load(std::memory_order_relaxed);
+    } // end size()
+
+    // returns the number of bytes held by interned types
+    inline std::size_t bytes(void) const
+    {
+      return m_bytes.load(std::memory_order_relaxed);
+    } // end bytes()
+
+  private:
+    type_interner(const type_interner &);
+    type_interner &operator=(const type_interner &);
+
+    // a thread's recently interned nodes, indexed by hash
+    // the serial number of an entry's interner tells apart interners which
+    // have occupied the same address
+    struct cache_entry
+    {
+      std::size_t  m_serial;
+      const node  *m_node;
+    }; // end cache_entry
+
+    static const std::size_t cache_size = 256;
+
+    inline static cache_entry *thread_cache(void)
+    {
+      static thread_local cache_entry result[cache_size] = {};
+      return result;
+    } // end thread_cache()
+
+    inline static std::atomic<std::size_t> &next_serial(void)
+    {
+      // 0 marks an empty cache entry
+      static std::atomic<std::size_t> result(1);
+      return result;
+    } // end next_serial()
+
+    inline static std::size_t round_up(const std::size_t n)
+    {
+      std::size_t result = 1;
+      while(result < n)
+      {
+        result <<= 1;
+      } // end while
+
+      return result;
+    } // end round_up()
+
+    inline static std::size_t hash(const bool is_variable, const std::size_t label, const handle *children, const std::size_t size)
+    {
+      std::size_t seed = is_variable;
+      boost::hash_combine(seed, label);
+      for(std::size_t i = 0; i < size; ++i)
+      {
+        boost::hash_combine(seed, children[i]->hash());
+      } // end for i
+
+      return seed;
+    } // end hash()
+
+    inline static std::size_t node_bytes(const std::size_t size)
+    {
+      return sizeof(node) + size * sizeof(handle);
+    } // end node_bytes()
+
+    inline static node *allocate(const bool is_variable, const std::size_t label, const handle *children, const std::size_t size, const std::size_t hash)
+    {
+      // interned types outlive any query, so they never come from the current resource
+      node *result = new(::operator new(node_bytes(size))) node(is_variable, label, size, hash);
+      std::copy(children, children + size, result->children());
+      return result;
+    } // end allocate()
+
+    inline static void deallocate(const node *n)
+    {
+      ::operator delete(const_cast<node*>(n));
+    } // end deallocate()
+
+    // returns the node of [first, last) matching the given type, or null
+    inline static const node *find(const node *first, const node *last, const bool is_variable, const std::size_t label, const handle *children, const std::size_t size, const std::size_t hash)
+    {
+      for(; first != last; first = first->m_next)
+      {
+        if(first->m_hash == hash && first->matches(is_variable, label, children, size))
+        {
+          return first;
+        } // end if
+      } // end for
+
+      return 0;
+    } // end find()
+
+    inline handle insert(const bool is_variable, const std::size_t label, const handle *children, const std::size_t size)
+    {
+      std::size_t h = hash(is_variable, label, children, size);
+
+      cache_entry &cached = thread_cache()[h % cache_size];
+      if(cached.m_serial == m_serial && cached.m_node->m_hash == h && cached.m_node->matches(is_variable, label, children, size))
+      {
+        return cached.m_node;
+      } // end if
+
+      auto &bucket = m_buckets[h & m_mask];
+      const node *head = bucket.load(std::memory_order_acquire);
+
+      const node *result = find(head, 0, is_variable, label, children, size, h);
+      if(!result)
+      {
+        node *fresh = allocate(is_variable, label, children, size, h);
+
+        while(true)
+        {
+          fresh->m_next = head;
+          if(bucket.compare_exchange_weak(head, fresh, std::memory_order_release, std::memory_order_acquire))
+          {
+            m_size.fetch_add(1, std::memory_order_relaxed);
+            m_bytes.fetch_add(node_bytes(size), std::memory_order_relaxed);
+            result = fresh;
+            break;
+          } // end if
+
+          // another thread may have published the same type meanwhile, and
+          // only the nodes ahead of the old head are new
+          result = find(head, fresh->m_next, is_variable, label, children, size, h);
+          if(result)
+          {
+            deallocate(fresh);
+            break;
+          } // end if
+        } // end while
+      } // end if
+
+      cached.m_serial = m_serial;
+      cached.m_node = result;
+      return result;
+    } // end insert()
+
+    std::size_t                                    m_mask;
+    std::unique_ptr<std::atomic<const node*>[]>    m_buckets;
+    std::size_t                                    m_serial;
+    std::atomic<std::size_t>                       m_size;
+    std::atomic<std::size_t>                       m_bytes;
+}; // end type_interner
+
+} // end unification
@@ -0,0 +1,331 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <set>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <exception>
+#include <climits>
+#include "unification.hpp"
+#include "syntax.hpp"
+#include "dependencies.hpp"
+#include "inference.hpp"
+#include "intern.hpp"
+
+namespace inference
+{
+
+// infers the types of a module's top-level definitions in parallel
+//
+// the definitions are split into strongly connected components as in a
+// syntax::letrec_group. a component is ready once every component it depends
+// on has been generalized, and ready components are inferred concurrently on
+// a pool of workers which steal from each other when they run dry
+//
+// each component is inferred by its own inferencer, with its own
+// substitution, in an environment holding only the prelude and the schemes
+// of the definitions it refers to. each is given a disjoint range of unique
+// ids, so that the variables of a scheme published by one component never
+// collide with the variables of the component which instantiates it
+//
+// the schemes the workers publish are kept in a type_interner, so equal
+// schemes, and the equal parts of different ones, are stored once however
+// many workers inferred them. checkers given the same interner share their
+// schemes too
+class module_checker
+{
+  public:
+    typedef syntax::letrec_group::binding definition;
+
+    // the definitions, the environment and the interner, if given, must
+    // outlive the checker
+    inline module_checker(const std::vector<definition> &definitions,
+                          const environment &env,
+                          const std::size_t num_threads = std::thread::hardware_concurrency(),
+                          unification::type_interner *interner = 0)
+      : m_definitions(definitions),
+        m_environment(env),
+        m_num_threads(std::max<std::size_t>(num_threads, 1)),
+        m_own_interner(interner ? 0 : new unification::type_interner(16 * definitions.size())),
+        m_interner(interner ? interner : m_own_interner.get()),
+        m_graph(syntax::analyze_dependencies(definitions)),
+        m_types(definitions.size()),
+        m_dependents(m_graph.m_components.size()),
+        m_pending(new std::atomic<std::size_t>[m_graph.m_components.size()]),
+        m_queues(m_num_threads),
+        m_remaining(m_graph.m_components.size()),
+        m_failed(false),
+        m_published(0)
+    {
+      // ids below first_id belong to env
+      environment copy = env;
+      m_first_id = copy.unique_id();
+
+      // find the components each component depends on
+      for(std::size_t c = 0; c < m_graph.m_components.size(); ++c)
+      {
+        std::set<std::size_t> dependencies;
+
+        auto &members = m_graph.m_components[c];
+        for(auto i = members.begin(); i != members.end(); ++i)
+        {
+          auto &edges = m_graph.m_edges[*i];
+          for(auto j = edges.begin(); j != edges.end(); ++j)
+          {
+            if(m_graph.m_component_of[*j] != c)
+            {
+              dependencies.insert(m_graph.m_component_of[*j]);
+            } // end if
+          } // end for j
+        } // end for i
+
+        for(auto d = dependencies.begin(); d != dependencies.end(); ++d)
+        {
+          m_dependents[*d].push_back(c);
+        } // end for d
+
+        m_pending[c] = dependencies.size();
+      } // end for c
+    } // end module_checker()
+
+    // returns the generalized type of each definition
+    // rethrows the first error encountered by any component
+    inline std::vector<type> check(void)
+    {
+      // deal the ready components among the workers
+      for(std::size_t c = 0, worker = 0; c < m_graph.m_components.size(); ++c)
+      {
+        if(m_pending[c] == 0)
+        {
+          m_queues[worker].m_components.push_back(c);
+          worker = (worker + 1) % m_num_threads;
+        } // end if
+      } // end for c
+
+      std::vector<std::thread> threads;
+      for(std::size_t i = 1; i < m_num_threads; ++i)
+      {
+        threads.push_back(std::thread(&module_checker::work, this, i));
+      } // end for i
+
+      work(0);
+
+      for(auto i = threads.begin();
+          i != threads.end();
+          ++i)
+      {
+        i->join();
+      } // end for i
+
+      if(m_error)
+      {
+        std::rethrow_exception(m_error);
+      } // end if
+
+      std::vector<type> result;
+      result.reserve(m_types.size());
+      for(auto i = m_types.begin(); i != m_types.end(); ++i)
+      {
+        result.push_back(unification::type_interner::extract(*i));
+      } // end for i
+
+      return result;
+    } // end check()
+
+  private:
+    struct queue
+    {
+      std::mutex              m_mutex;
+      std::deque<std::size_t> m_components;
+    }; // end queue
+
+    inline void work(const std::size_t self)
+    {
+      while(m_remaining > 0 && !m_failed)
+      {
+        std::size_t published = m_published;
+
+        std::size_t c = 0;
+        if(!pop(self, c))
+        {
+          // sleep until a component is pushed or the work is over
+          std::unique_lock<std::mutex> lock(m_idle_mutex);
+          m_idle.wait(lock, [&]
+          {
+            return m_published != published || m_remaining == 0 || m_failed;
+          });
+          continue;
+        } // end if
+
+        try
+        {
+          infer(c);
+        } // end try
+        catch(...)
+        {
+          std::lock_guard<std::mutex> lock(m_error_mutex);
+          if(!m_error)
+          {
+            m_error = std::current_exception();
+          } // end if
+
+          m_failed = true;
+          wake();
+          return;
+        } // end catch
+
+        // publish the component to its dependents
+        bool pushed = false;
+        for(auto d = m_dependents[c].begin(); d != m_dependents[c].end(); ++d)
+        {
+          if(--m_pending[*d] == 0)
+          {
+            push(self, *d);
+            pushed = true;
+          } // end if
+        } // end for d
+
+        if(--m_remaining == 0 || pushed)
+        {
+          wake();
+        } // end if
+      } // end while
+    } // end work()
+
+    // wakes the idle workers
+    // a worker which is about to sleep sees the count change, since it's
+    // changed under the lock the worker sleeps with
+    inline void wake(void)
+    {
+      {
+        std::lock_guard<std::mutex> lock(m_idle_mutex);
+        ++m_published;
+      }
+
+      m_idle.notify_all();
+    } // end wake()
+
+    // takes the newest component from our own queue, or else the oldest
+    // component from someone else's
+    inline bool pop(const std::size_t self, std::size_t &c)
+    {
+      {
+        std::lock_guard<std::mutex> lock(m_queues[self].m_mutex);
+        if(!m_queues[self].m_components.empty())
+        {
+          c = m_queues[self].m_components.back();
+          m_queues[self].m_components.pop_back();
+          return true;
+        } // end if
+      }
+
+      for(std::size_t i = 1; i < m_num_threads; ++i)
+      {
+        auto &victim = m_queues[(self + i) % m_num_threads];
+
+        std::lock_guard<std::mutex> lock(victim.m_mutex);
+        if(!victim.m_components.empty())
+        {
+          c = victim.m_components.front();
+          victim.m_components.pop_front();
+          return true;
+        } // end if
+      } // end for i
+
+      return false;
+    } // end pop()
+
+    inline void push(const std::size_t self, const std::size_t c)
+    {
+      std::lock_guard<std::mutex> lock(m_queues[self].m_mutex);
+      m_queues[self].m_components.push_back(c);
+    } // end push()
+
+    inline void infer(const std::size_t c)
+    {
+      auto &members = m_graph.m_components[c];
+
+      // a component's scratch memory comes from its thread's arena
+      auto types = unification::with_resource(unification::thread_arena(), [&]
+      {
+        environment env = m_environment;
+        env.reset_ids(m_first_id + c * id_range);
+
+        // bring the schemes of the component's dependencies into scope
+        for(auto i = members.begin(); i != members.end(); ++i)
+        {
+          auto &edges = m_graph.m_edges[*i];
+          for(auto j = edges.begin(); j != edges.end(); ++j)
+          {
+            if(m_graph.m_component_of[*j] != c)
+            {
+              env[m_definitions[*j].first] = unification::type_interner::extract(m_types[*j]);
+            } // end if
+          } // end for j
+        } // end for i
+
+        inferencer v(env);
+        auto variables = v.infer_component(m_definitions, members);
+
+        // every variable of a scheme is generic, so renaming them in order of
+        // appearance lets equal schemes of different components share
+        std::vector<unification::type_interner::handle> result;
+        for(auto i = variables.begin(); i != variables.end(); ++i)
+        {
+          auto scheme = resolve(v.m_substitution, *i);
+          std::map<type_variable,type_variable> names;
+          inferencer::rename(scheme, names);
+          result.push_back(m_interner->intern(scheme));
+        } // end for i
+
+        return result;
+      });
+
+      unification::thread_arena().release();
+
+      for(std::size_t i = 0; i < members.size(); ++i)
+      {
+        m_types[members[i]] = types[i];
+      } // end for i
+    } // end infer()
+
+    // the number of unique ids reserved for each component
+    static const std::size_t id_range = std::size_t(1) << (sizeof(std::size_t) * CHAR_BIT / 2);
+
+    const std::vector<definition>                    &m_definitions;
+    const environment                                &m_environment;
+    std::size_t                                       m_num_threads;
+    std::size_t                                       m_first_id;
+    std::unique_ptr<unification::type_interner>       m_own_interner;
+    unification::type_interner                       *m_interner;
+    syntax::dependency_graph                          m_graph;
+    std::vector<unification::type_interner::handle>   m_types;
+    std::vector<std::vector<std::size_t>>             m_dependents;
+    std::unique_ptr<std::atomic<std::size_t>[]>       m_pending;
+    std::vector<queue>                                m_queues;
+    std::atomic<std::size_t>                          m_remaining;
+    std::atomic<bool>                                 m_failed;
+    std::mutex                                        m_idle_mutex;
+    std::condition_variable                           m_idle;
+    std::atomic<std::size_t>                          m_published;
+    std::mutex                                        m_error_mutex;
+    std::exception_ptr                                m_error;
+}; // end module_checker
+
+// returns the generalized type of each of a module's definitions, inferring
+// independent definitions concurrently
+inline std::vector<type> check_module(const std::vector<syntax::letrec_group::binding> &definitions,
+                                      const environment &env,
+                                      const std::size_t num_threads = std::thread::hardware_concurrency(),
+                                      unification::type_interner *interner = 0)
+{
+  module_checker checker(definitions, env, num_threads, interner);
+  return checker.check();
+} // end check_module()
+
+} // end inference
@@ -0,0 +1,498 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <stdexcept>
+#include <boost/variant.hpp>
+#include <boost/functional/hash.hpp>
+#include "unification.hpp"
+#include "syntax.hpp"
+#include "dependencies.hpp"
+#include "inference.hpp"
+
+namespace inference
+{
+
+namespace detail
+{
+
+// the types of a node of a specialized tree and of its subterms, in the
+// order syntax::children() lists them
+struct specialization_shape
+{
+  type                              m_type;
+  std::vector<specialization_shape> m_children;
+}; // end specialization_shape
+
+inline std::size_t hash(const type &x)
+{
+  if(auto var = boost::get<type_variable>(&x))
+  {
+    std::size_t seed = 0;
+    boost::hash_combine(seed, var->id());
+    return seed;
+  } // end if
+
+  auto &op = boost::get<type_operator>(x);
+  std::size_t seed = 1;
+  boost::hash_combine(seed, op.kind());
+  for(auto i = op.begin(); i != op.end(); ++i)
+  {
+    boost::hash_combine(seed, hash(*i));
+  } // end for i
+
+  return seed;
+} // end hash()
+
+// returns true if x contains no type variables
+inline bool is_ground(const type &x)
+{
+  auto op = boost::get<type_operator>(&x);
+  return op && std::all_of(op->begin(), op->end(), [](const type &child)
+  {
+    return is_ground(child);
+  });
+} // end is_ground()
+
+// rebuilds a tree with each generalized binding replaced by a copy for each
+// distinct ground instantiation of it among its uses
+//
+// the bodies of let and letrec ... and ... are specialized before their
+// definitions, so that the uses of a binding, including those in the copies
+// of bindings nested within its body, are known when its copies are made. a
+// copy is specialized with the binding's generic variables replaced by the
+// types its uses instantiated them with, so the bindings nested within a copy
+// are specialized at ground types in turn
+class specializer
+{
+  public:
+    typedef std::pair<syntax::node, specialization_shape> result_type;
+
+    inline specializer(const type_table &table, const instantiation_log &log)
+      : m_table(table),
+        m_log(log),
+        m_num_names(0),
+        m_num_copies(0)
+    {}
+
+    inline result_type operator()(const syntax::node &n)
+    {
+      auto t = m_table.find(n);
+      if(!t)
+      {
+        throw std::logic_error("monomorphize: a node has no type");
+      } // end if
+
+      auto result = boost::apply_visitor(dispatcher(*this, n), n);
+      result.second.m_type = resolve(m_substitution, *t);
+      return result;
+    } // end operator()()
+
+    // returns the number of copies made at ground types
+    inline std::size_t num_copies(void) const
+    {
+      return m_num_copies;
+    } // end num_copies()
+
+  private:
+    typedef instantiation_log::instantiation instantiation;
+
+    // dispatches a node to the specializer's rule for it
+    struct dispatcher
+      : boost::static_visitor<result_type>
+    {
+      inline dispatcher(specializer &s, const syntax::node &n)
+        : m_specializer(s),
+          m_node(n)
+      {}
+
+      template<typename T>
+        inline result_type operator()(const T &x) const
+      {
+        return m_specializer.specialize(x, m_node);
+      } // end operator()()
+
+      specializer        &m_specializer;
+      const syntax::node &m_node;
+    }; // end dispatcher
+
+    // a name in scope
+    struct binding
+    {
+      inline binding(const std::string &name, const bool generalized)
+        : m_name(name),
+          m_renamed(name),
+          m_generalized(generalized)
+      {}
+
+      inline binding(const std::string &name, const std::string &renamed)
+        : m_name(name),
+          m_renamed(renamed),
+          m_generalized(false)
+      {}
+
+      std::string                                       m_name;
+      // a use of a binding which isn't generalized refers to m_renamed
+      std::string                                       m_renamed;
+      bool                                              m_generalized;
+      // the distinct instantiations of the binding among its uses so far, and
+      // the name of each one's copy
+      // an instantiation which isn't ground is empty, and its copy keeps the
+      // binding's name and generic variables
+      std::vector<instantiation>                        m_instances;
+      std::vector<std::string>                          m_names;
+      std::unordered_multimap<std::size_t, std::size_t> m_index;
+    }; // end binding
+
+    // names a copy uniquely, so that no copy captures a use of another
+    inline std::string fresh_name(const std::string &name)
+    {
+      return name + "#" + std::to_string(++m_num_names);
+    } // end fresh_name()
+
+    // returns the name of the copy of b which a use instantiating it with x
+    // refers to, making the copy if it is new
+    inline std::string use(binding &b, const instantiation *x)
+    {
+      instantiation key;
+      std::size_t seed = 0;
+      if(x)
+      {
+        for(auto i = x->begin(); i != x->end(); ++i)
+        {
+          key.push_back(std::make_pair(i->first, resolve(m_substitution, i->second)));
+          boost::hash_combine(seed, hash(key.back().second));
+        } // end for i
+      } // end if
+
+      if(!std::all_of(key.begin(), key.end(), [](const std::pair<type_variable,type> &v){ return is_ground(v.second); }))
+      {
+        key.clear();
+        seed = 0;
+      } // end if
+
+      auto range = b.m_index.equal_range(seed);
+      for(auto i = range.first; i != range.second; ++i)
+      {
+        if(same_types(b.m_instances[i->second], key))
+        {
+          return b.m_names[i->second];
+        } // end if
+      } // end for i
+
+      b.m_index.insert(std::make_pair(seed, b.m_instances.size()));
+      b.m_names.push_back(key.empty() ? b.m_name : fresh_name(b.m_name));
+      b.m_instances.push_back(std::move(key));
+      return b.m_names.back();
+    } // end use()
+
+    inline static bool same_types(const instantiation &x, const instantiation &y)
+    {
+      return x.size() == y.size() && std::equal(x.begin(), x.end(), y.begin(), [](const std::pair<type_variable,type> &a, const std::pair<type_variable,type> &b)
+      {
+        return a.second == b.second;
+      });
+    } // end same_types()
+
+    // specializes n with the variables of x replaced by their types
+    inline result_type specialize(const syntax::node &n, const instantiation &x)
+    {
+      auto saved = m_substitution;
+      for(auto i = x.begin(); i != x.end(); ++i)
+      {
+        m_substitution[i->first] = i->second;
+      } // end for i
+
+      auto result = (*this)(n);
+      m_substitution.swap(saved);
+      return result;
+    } // end specialize()
+
+    inline static result_type make(syntax::node &&n, std::vector<specialization_shape> &&children = std::vector<specialization_shape>())
+    {
+      result_type result(std::move(n), specialization_shape());
+      result.second.m_children = std::move(children);
+      return result;
+    } // end make()
+
+    inline result_type specialize(const syntax::integer_literal &il, const syntax::node &)
+    {
+      return make(il);
+    } // end specialize()
+
+    inline result_type specialize(const syntax::identifier &id, const syntax::node &n)
+    {
+      binding *b = 0;
+      for(auto i = m_scope.rbegin(); !b && i != m_scope.rend(); ++i)
+      {
+        if((*i)->m_name == id.name())
+        {
+          b = *i;
+        } // end if
+      } // end for i
+
+      if(!b)
+      {
+        return make(id);
+      } // end if
+
+      return make(syntax::identifier(b->m_generalized ? use(*b, m_log.find(n)) : b->m_renamed));
+    } // end specialize()
+
+    inline result_type specialize(const syntax::apply &app, const syntax::node &)
+    {
+      auto function = (*this)(app.function());
+      auto argument = (*this)(app.argument());
+      return make(syntax::apply(std::move(function.first), std::move(argument.first)),
+                  {std::move(function.second), std::move(argument.second)});
+    } // end specialize()
+
+    inline result_type specialize(const syntax::lambda &l, const syntax::node &)
+    {
+      binding parameter(l.parameter(), false);
+      m_scope.push_back(&parameter);
+      auto body = (*this)(l.body());
+      m_scope.pop_back();
+
+      return make(syntax::lambda(l.parameter(), std::move(body.first)), {std::move(body.second)});
+    } // end specialize()
+
+    // let x = d in b becomes let x#1 = d1 in let x#2 = d2 in ... b, with a
+    // copy for each instantiation of x in b. a binding with no uses is dropped
+    inline result_type specialize(const syntax::let &l, const syntax::node &)
+    {
+      binding b(l.name(), true);
+      m_scope.push_back(&b);
+      auto result = (*this)(l.body());
+      m_scope.pop_back();
+
+      // the copy which keeps x's name goes innermost, so that it captures no
+      // use of an outer x in the other copies
+      std::vector<std::size_t> order;
+      for(std::size_t i = 0; i < b.m_instances.size(); ++i)
+      {
+        if(!b.m_instances[i].empty()) order.push_back(i);
+      } // end for i
+
+      for(std::size_t i = 0; i < b.m_instances.size(); ++i)
+      {
+        if(b.m_instances[i].empty()) order.push_back(i);
+      } // end for i
+
+      for(auto i = order.rbegin(); i != order.rend(); ++i)
+      {
+        auto definition = specialize(l.definition(), b.m_instances[*i]);
+        m_num_copies += !b.m_instances[*i].empty();
+
+        auto t = result.second.m_type;
+        result = make(syntax::let(b.m_names[*i], std::move(definition.first), std::move(result.first)),
+                      {std::move(definition.second), std::move(result.second)});
+        result.second.m_type = t;
+      } // end for i
+
+      return result;
+    } // end specialize()
+
+    // letrec isn't generalized, so it needn't be copied
+    inline result_type specialize(const syntax::letrec &l, const syntax::node &)
+    {
+      binding b(l.name(), false);
+      m_scope.push_back(&b);
+      auto definition = (*this)(l.definition());
+      auto body = (*this)(l.body());
+      m_scope.pop_back();
+
+      return make(syntax::letrec(l.name(), std::move(definition.first), std::move(body.first)),
+                  {std::move(definition.second), std::move(body.second)});
+    } // end specialize()
+
+    // each strongly connected component of a group is generalized as a
+    // whole, so each instantiation of a member copies its whole component.
+    // within a copy the members refer to each other monomorphically. the
+    // copies of all components go into one group
+    inline result_type specialize(const syntax::letrec_group &g, const syntax::node &)
+    {
+      auto &bindings = g.bindings();
+      auto components = syntax::analyze_dependencies(bindings).m_components;
+
+      std::vector<binding> members;
+      members.reserve(bindings.size());
+      for(auto i = bindings.begin(); i != bindings.end(); ++i)
+      {
+        members.push_back(binding(i->first, true));
+        m_scope.push_back(&members.back());
+      } // end for i
+
+      auto body = (*this)(g.body());
+
+      // a component is used only by the components after it, so its
+      // instantiations are all known once they have been copied
+      std::vector<std::vector<std::pair<std::string, result_type>>> copies(components.size());
+      for(std::size_t c = components.size(); c > 0; --c)
+      {
+        auto &component = components[c - 1];
+
+        bool generic = false;
+        for(auto m = component.begin(); m != component.end(); ++m)
+        {
+          for(std::size_t k = 0; k < members[*m].m_instances.size(); ++k)
+          {
+            const instantiation &x = members[*m].m_instances[k];
+            if(x.empty() && generic) continue;
+            generic = generic || x.empty();
+
+            // within the copy, each member's name refers to its copy
+            std::vector<binding> renames;
+            renames.reserve(component.size());
+            for(auto s = component.begin(); s != component.end(); ++s)
+            {
+              auto &name = bindings[*s].first;
+              renames.push_back(binding(name, (*s == *m) ? members[*m].m_names[k] : (x.empty() ? name : fresh_name(name))));
+            } // end for s
+
+            for(std::size_t s = 0; s < component.size(); ++s)
+            {
+              m_scope.push_back(&renames[s]);
+            } // end for s
+
+            for(std::size_t s = 0; s < component.size(); ++s)
+            {
+              copies[c - 1].push_back(std::make_pair(renames[s].m_renamed, specialize(bindings[component[s]].second, x)));
+              m_num_copies += !x.empty();
+            } // end for s
+
+            m_scope.resize(m_scope.size() - component.size());
+          } // end for k
+        } // end for m
+      } // end for c
+
+      m_scope.resize(m_scope.size() - bindings.size());
+
+      if(std::all_of(copies.begin(), copies.end(), [](const std::vector<std::pair<std::string, result_type>> &x){ return x.empty(); }))
+      {
+        return body;
+      } // end if
+
+      std::vector<syntax::letrec_group::binding> result;
+      std::vector<specialization_shape> children;
+      for(auto c = copies.begin(); c != copies.end(); ++c)
+      {
+        for(auto i = c->begin(); i != c->end(); ++i)
+        {
+          result.push_back(syntax::letrec_group::binding(i->first, std::move(i->second.first)));
+          children.push_back(std::move(i->second.second));
+        } // end for i
+      } // end for c
+
+      children.push_back(std::move(body.second));
+      return make(syntax::letrec_group(std::move(result), std::move(body.first)), std::move(children));
+    } // end specialize()
+
+    inline result_type specialize(const syntax::record &r, const syntax::node &)
+    {
+      std::vector<syntax::record::field> fields;
+      std::vector<specialization_shape> children;
+      for(auto i = r.fields().begin(); i != r.fields().end(); ++i)
+      {
+        auto field = (*this)(i->second);
+        fields.push_back(syntax::record::field(i->first, std::move(field.first)));
+        children.push_back(std::move(field.second));
+      } // end for i
+
+      return make(syntax::record(std::move(fields)), std::move(children));
+    } // end specialize()
+
+    inline result_type specialize(const syntax::selection &s, const syntax::node &)
+    {
+      auto record = (*this)(s.record());
+      return make(syntax::selection(std::move(record.first), s.label()), {std::move(record.second)});
+    } // end specialize()
+
+    const type_table        &m_table;
+    const instantiation_log &m_log;
+    // the types of the generic variables of the copies being made
+    substitution_map         m_substitution;
+    // the innermost binding of a name is last
+    std::vector<binding*>    m_scope;
+    std::size_t              m_num_names;
+    std::size_t              m_num_copies;
+}; // end specializer
+
+} // end detail
+
+// a program in which every generalized binding has been specialized at the
+// ground types it is used with
+class specialized_program
+{
+  public:
+    inline specialized_program(syntax::node &&tree, const detail::specialization_shape &shape, const std::size_t num_copies)
+      : m_tree(new syntax::node(std::move(tree))),
+        m_num_copies(num_copies)
+    {
+      // the tree no longer moves, so its nodes' addresses identify them
+      annotate(*m_tree, shape);
+      m_types.close(substitution_map());
+    } // end specialized_program()
+
+    inline const syntax::node &tree(void) const
+    {
+      return *m_tree;
+    } // end tree()
+
+    // the type of each node of tree()
+    // a type is ground unless it involves a binding used only at types which
+    // aren't, or a variable which no use determines, such as the type of an
+    // unused parameter
+    inline const type_table &types(void) const
+    {
+      return m_types;
+    } // end types()
+
+    // returns the number of bindings of tree() which are copies made at ground types
+    inline std::size_t num_copies(void) const
+    {
+      return m_num_copies;
+    } // end num_copies()
+
+  private:
+    inline void annotate(const syntax::node &n, const detail::specialization_shape &shape)
+    {
+      m_types.record(n, shape.m_type);
+
+      auto children = syntax::children(n);
+      for(std::size_t i = 0; i < children.size(); ++i)
+      {
+        annotate(*children[i], shape.m_children[i]);
+      } // end for i
+    } // end annotate()
+
+    std::unique_ptr<syntax::node> m_tree;
+    type_table                    m_types;
+    std::size_t                   m_num_copies;
+}; // end specialized_program
+
+// infers the type of n and returns the program with each generalized
+// binding replaced by one copy for each distinct ground type it is used at
+//
+// copies of a binding are told apart by the hash of the types its generic
+// variables are instantiated with, and are named x#1, x#2, and so on, which
+// the parser never produces. uses of a binding at types which aren't ground
+// share one copy with the binding's name, and a generalized binding which is
+// never used is dropped. bindings nested within copies are copied in turn, so
+// a program can have exponentially more copies than bindings
+//
+// throws as infer_type() does if n is ill-typed
+inline specialized_program monomorphize(const syntax::node &n, const environment &env)
+{
+  type_table table;
+  instantiation_log log;
+  infer_type(n, env, table, log);
+
+  detail::specializer s(table, log);
+  auto result = s(n);
+  return specialized_program(std::move(result.first), result.second, s.num_copies());
+} // end monomorphize()
+
+} // end inference
@@ -0,0 +1,488 @@
+#pragma once
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cctype>
+#include <stdexcept>
+#include "syntax.hpp"
+
+namespace syntax
+{
+
+// a top-level declaration, whose bindings are in scope in the declarations
+// which follow it
+struct declaration
+{
+  inline declaration()
+    : m_recursive(false)
+  {}
+
+  // whether the bindings are in scope in their own definitions
+  bool                               m_recursive;
+  std::vector<letrec_group::binding> m_bindings;
+};
+
+struct parse_error
+  : std::runtime_error
+{
+  inline parse_error(const std::string &what, const std::size_t offset)
+    : std::runtime_error(what),
+      position(offset)
+  {}
+
+  // the offset of the offending character in the input
+  std::size_t position;
+};
+
+// parses the syntax printed by syntax.hpp's operator<<:
+//
+//   expression  := "fn" name "=>" expression
+//                | "let" name "=" expression "in" expression
+//                | "letrec" binding ("and" binding)* "in" expression
+//                | application
+//   application := atom atom*
+//   binding     := name "=" expression
+//   atom        := primary ("." name)*
+//   primary     := integer | name | "(" expression ")"
+//                | "{" (binding ("," binding)*)? "}"
+//
+// application associates to the left, and the body of fn, let and letrec
+// extends as far to the right as possible. selection binds more tightly than
+// application, so f r.x applies f to r.x
+//
+// a program is a sequence of top-level declarations, which parse_declaration()
+// reads one at a time:
+//
+//   declaration := "let" binding
+//                | "letrec" binding ("and" binding)*
+//
+// input which nests more deeply than max_depth is a parse error, rather than
+// an overflow of the stack of the parser or of whatever walks the tree
+class parser
+{
+  public:
+    // counting the productions the parser is within, and the arguments and
+    // selections applied to each
+    static const std::size_t max_depth = 1 << 12;
+
+    inline parser(std::istream &is)
+      : m_is(is),
+        m_offset(0),
+        m_peeked(false),
+        m_depth(0)
+    {}
+
+    // parses the next expression from the stream
+    inline node parse_expression(void)
+    {
+      nesting n(*this);
+
+      if(peek_keyword("fn"))
+      {
+        next();
+        auto param = expect_name();
+        expect(arrow, "=>");
+        auto body = parse_expression();
+        return lambda(param, std::move(body));
+      } // end if
+      else if(peek_keyword("let"))
+      {
+        next();
+        auto name = expect_name();
+        expect(equals, "=");
+        auto def = parse_expression();
+        expect_keyword("in");
+        auto body = parse_expression();
+        return let(name, std::move(def), std::move(body));
+      } // end else if
+      else if(peek_keyword("letrec"))
+      {
+        next();
+        auto bindings = parse_bindings();
+        expect_keyword("in");
+        auto body = parse_expression();
+
+        // a single binding is an ordinary letrec
+        if(bindings.size() == 1)
+        {
+          return letrec(bindings[0].first, std::move(bindings[0].second), std::move(body));
+        } // end if
+
+        return letrec_group(std::move(bindings), std::move(body));
+      } // end else if
+
+      return parse_application();
+    } // end parse_expression()
+
+    // parses the next top-level declaration from the stream
+    inline declaration parse_declaration(void)
+    {
+      declaration result;
+
+      if(peek_keyword("let"))
+      {
+        next();
+        result.m_recursive = false;
+
+        auto name = expect_name();
+        expect(equals, "=");
+        result.m_bindings.push_back(letrec_group::binding(name, parse_expression()));
+      } // end if
+      else if(peek_keyword("letrec"))
+      {
+        next();
+        result.m_recursive = true;
+        result.m_bindings = parse_bindings();
+      } // end else if
+      else
+      {
+        fail("expected let or letrec", peek());
+      } // end else
+
+      return result;
+    } // end parse_declaration()
+
+    // returns true if nothing but whitespace remains in the stream
+    inline bool at_end(void)
+    {
+      return peek().m_kind == end;
+    } // end at_end()
+
+    // returns the offset of the next unconsumed character
+    inline std::size_t offset(void) const
+    {
+      return m_offset;
+    } // end offset()
+
+  protected:
+    enum token_kind
+    {
+      end,
+      integer,
+      name,
+      left,
+      right,
+      arrow,
+      equals,
+      left_brace,
+      right_brace,
+      comma,
+      dot
+    }; // end token_kind
+
+    struct token
+    {
+      token_kind  m_kind;
+      std::string m_text;
+      std::size_t m_offset;
+    }; // end token
+
+    inline bool is_keyword(const std::string &text) const
+    {
+      return text == "fn" || text == "let" || text == "letrec" || text == "and" || text == "in";
+    } // end is_keyword()
+
+    inline const token &peek(void)
+    {
+      if(!m_peeked)
+      {
+        m_token = read_token();
+        m_peeked = true;
+      } // end if
+
+      return m_token;
+    } // end peek()
+
+    inline token next(void)
+    {
+      peek();
+      m_peeked = false;
+      return m_token;
+    } // end next()
+
+    inline bool peek_keyword(const char *keyword)
+    {
+      return peek().m_kind == name && m_token.m_text == keyword;
+    } // end peek_keyword()
+
+    inline void expect(const token_kind kind, const char *what)
+    {
+      auto t = next();
+      if(t.m_kind != kind)
+      {
+        fail(std::string("expected ") + what, t);
+      } // end if
+    } // end expect()
+
+    inline void expect_keyword(const char *keyword)
+    {
+      auto t = next();
+      if(t.m_kind != name || t.m_text != keyword)
+      {
+        fail(std::string("expected ") + keyword, t);
+      } // end if
+    } // end expect_keyword()
+
+    inline std::string expect_name(void)
+    {
+      auto t = next();
+      if(t.m_kind != name || is_keyword(t.m_text))
+      {
+        fail("expected a name", t);
+      } // end if
+
+      return t.m_text;
+    } // end expect_name()
+
+    inline void fail(const std::string &what, const token &t) const
+    {
+      std::ostringstream os;
+      os << "parse error at " << t.m_offset << ": " << what;
+
+      if(t.m_kind == end)
+      {
+        os << " before end of input";
+      } // end if
+      else
+      {
+        os << " but found " << t.m_text;
+      } // end else
+
+      throw parse_error(os.str(), t.m_offset);
+    } // end fail()
+
+  private:
+    // restores the depth of nesting when a production returns
+    struct nesting
+    {
+      inline nesting(parser &p)
+        : m_parser(p),
+          m_depth(p.m_depth)
+      {
+        p.deeper();
+      } // end nesting()
+
+      inline ~nesting()
+      {
+        m_parser.m_depth = m_depth;
+      } // end ~nesting()
+
+      parser      &m_parser;
+      std::size_t  m_depth;
+    }; // end nesting
+
+    inline void deeper(void)
+    {
+      if(m_depth == max_depth)
+      {
+        fail("expression nested too deeply", peek());
+      } // end if
+
+      ++m_depth;
+    } // end deeper()
+
+    // binding ("and" binding)*
+    inline std::vector<letrec_group::binding> parse_bindings(void)
+    {
+      std::vector<letrec_group::binding> result;
+
+      while(true)
+      {
+        auto name = expect_name();
+        expect(equals, "=");
+        result.push_back(letrec_group::binding(name, parse_expression()));
+
+        if(!peek_keyword("and")) break;
+        next();
+      } // end while
+
+      return result;
+    } // end parse_bindings()
+
+    inline bool starts_atom(const token &t) const
+    {
+      return t.m_kind == integer || t.m_kind == left || t.m_kind == left_brace || (t.m_kind == name && !is_keyword(t.m_text));
+    } // end starts_atom()
+
+    inline node parse_application(void)
+    {
+      nesting n(*this);
+      node result = parse_atom();
+
+      // each argument nests the application one level deeper
+      while(starts_atom(peek()))
+      {
+        deeper();
+        result = apply(std::move(result), parse_atom());
+      } // end while
+
+      return result;
+    } // end parse_application()
+
+    inline node parse_atom(void)
+    {
+      nesting n(*this);
+      node result = parse_primary();
+
+      while(peek().m_kind == dot)
+      {
+        deeper();
+        next();
+        result = selection(std::move(result), expect_name());
+      } // end while
+
+      return result;
+    } // end parse_atom()
+
+    inline node parse_primary(void)
+    {
+      auto t = next();
+
+      if(t.m_kind == integer)
+      {
+        std::istringstream is(t.m_text);
+        int value = 0;
+        if(!(is >> value))
+        {
+          fail("integer out of range", t);
+        } // end if
+
+        return integer_literal(value);
+      } // end if
+      else if(t.m_kind == name && !is_keyword(t.m_text))
+      {
+        return identifier(t.m_text);
+      } // end else if
+      else if(t.m_kind == left)
+      {
+        auto result = parse_expression();
+        expect(right, ")");
+        return result;
+      } // end else if
+      else if(t.m_kind == left_brace)
+      {
+        std::vector<record::field> fields;
+
+        if(peek().m_kind != right_brace)
+        {
+          while(true)
+          {
+            auto label = expect_name();
+            expect(equals, "=");
+            fields.push_back(record::field(label, parse_expression()));
+
+            if(peek().m_kind != comma) break;
+            next();
+          } // end while
+        } // end if
+
+        expect(right_brace, "}");
+        return record(std::move(fields));
+      } // end else if
+
+      fail("expected an expression", t);
+      return node(integer_literal(0));
+    } // end parse_primary()
+
+    inline int get(void)
+    {
+      int c = m_is.get();
+      if(c != std::char_traits<char>::eof())
+      {
+        ++m_offset;
+      } // end if
+
+      return c;
+    } // end get()
+
+    inline token read_token(void)
+    {
+      while(std::isspace(m_is.peek()))
+      {
+        get();
+      } // end while
+
+      token result;
+      result.m_offset = m_offset;
+
+      int c = get();
+
+      if(c == std::char_traits<char>::eof())
+      {
+        result.m_kind = end;
+      } // end if
+      else if(c == '(' || c == ')')
+      {
+        result.m_kind = (c == '(') ? left : right;
+        result.m_text = static_cast<char>(c);
+      } // end else if
+      else if(c == '{' || c == '}' || c == ',' || c == '.')
+      {
+        result.m_kind = (c == '{') ? left_brace : (c == '}') ? right_brace : (c == ',') ? comma : dot;
+        result.m_text = static_cast<char>(c);
+      } // end else if
+      else if(c == '=')
+      {
+        result.m_kind = equals;
+        result.m_text = "=";
+
+        if(m_is.peek() == '>')
+        {
+          get();
+          result.m_kind = arrow;
+          result.m_text = "=>";
+        } // end if
+      } // end else if
+      else if(std::isdigit(c) || (c == '-' && std::isdigit(m_is.peek())))
+      {
+        result.m_kind = integer;
+        result.m_text = static_cast<char>(c);
+        while(std::isdigit(m_is.peek()))
+        {
+          result.m_text += static_cast<char>(get());
+        } // end while
+      } // end else if
+      else if(std::isalpha(c) || c == '_')
+      {
+        result.m_kind = name;
+        result.m_text = static_cast<char>(c);
+        while(std::isalnum(m_is.peek()) || m_is.peek() == '_' || m_is.peek() == '\'')
+        {
+          result.m_text += static_cast<char>(get());
+        } // end while
+      } // end else if
+      else
+      {
+        result.m_kind = name;
+        result.m_text = static_cast<char>(c);
+        fail("unexpected character", result);
+      } // end else
+
+      return result;
+    } // end read_token()
+
+    std::istream &m_is;
+    std::size_t   m_offset;
+    token         m_token;
+    bool          m_peeked;
+    std::size_t   m_depth;
+}; // end parser
+
+// parses text, which must contain exactly one expression
+inline node parse(const std::string &text)
+{
+  std::istringstream is(text);
+  parser p(is);
+  auto result = p.parse_expression();
+
+  if(!p.at_end())
+  {
+    throw parse_error("parse error: unexpected input after expression", p.offset());
+  } // end if
+
+  return result;
+} // end parse()
+
+} // end syntax
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+namespace benchmark
+{
+
+// hardware_counters reads the processor's performance counters for the
+// calling thread through perf_event_open(2)
+//
+// each event is opened on its own, so that the events a machine or a
+// container allows are read even if others are refused. an event which
+// can't be opened is unavailable, and a program should report only the
+// events which are available. off Linux, none are
+class hardware_counters
+{
+  public:
+    enum event
+    {
+      cycles,
+      instructions,
+      l1d_misses,
+      llc_misses,
+      branch_misses,
+      num_events
+    }; // end event
+
+    inline static const char *name(const event e)
+    {
+      static const char *names[] = {"cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses"};
+      return names[e];
+    } // end name()
+
+    inline hardware_counters()
+    {
+      for(int e = 0; e < num_events; ++e)
+      {
+        m_fds[e] = open(event(e));
+      } // end for e
+    } // end hardware_counters()
+
+    inline ~hardware_counters()
+    {
+#ifdef __linux__
+      for(int e = 0; e < num_events; ++e)
+      {
+        if(m_fds[e] >= 0) close(m_fds[e]);
+      } // end for e
+#endif
+    } // end ~hardware_counters()
+
+    inline bool available(const event e) const
+    {
+      return m_fds[e] >= 0;
+    } // end available()
+
+    inline bool any_available(void) const
+    {
+      for(int e = 0; e < num_events; ++e)
+      {
+        if(available(event(e))) return true;
+      } // end for e
+
+      return false;
+    } // end any_available()
+
+    // zeroes and enables the counters
+    inline void start(void)
+    {
+#ifdef __linux__
+      for(int e = 0; e < num_events; ++e)
+      {
+        if(m_fds[e] < 0) continue;
+        ioctl(m_fds[e], PERF_EVENT_IOC_RESET, 0);
+        ioctl(m_fds[e], PERF_EVENT_IOC_ENABLE, 0);
+      } // end for e
+#endif
+    } // end start()
+
+    inline void stop(void)
+    {
+#ifdef __linux__
+      for(int e = 0; e < num_events; ++e)
+      {
+        if(m_fds[e] >= 0) ioctl(m_fds[e], PERF_EVENT_IOC_DISABLE, 0);
+      } // end for e
+#endif
+    } // end stop()
+
+    // returns the count of e between start() and stop(), scaled up if the
+    // kernel multiplexed the counter with others
+    inline std::uint64_t value(const event e) const
+    {
+#ifdef __linux__
+      // value, time enabled, time running
+      std::uint64_t buffer[3] = {0, 0, 0};
+      if(m_fds[e] < 0 || read(m_fds[e], buffer, sizeof(buffer)) != sizeof(buffer) || buffer[2] == 0)
+      {
+        return 0;
+      } // end if
+
+      return static_cast<std::uint64_t>(static_cast<double>(buffer[0]) * buffer[1] / buffer[2]);
+#else
+      return 0;
+#endif
+    } // end value()
+
+  private:
+    hardware_counters(const hardware_counters &);
+    hardware_counters &operator=(const hardware_counters &);
+
+    inline static int open(const event e)
+    {
+#ifdef __linux__
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.disabled = 1;
+      // user space only, which unprivileged processes are usually allowed
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+      switch(e)
+      {
+        case cycles:
+          attr.type = PERF_TYPE_HARDWARE;
+          attr.config = PERF_COUNT_HW_CPU_CYCLES;
+          break;
+
+        case instructions:
+          attr.type = PERF_TYPE_HARDWARE;
+          attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+          break;
+
+        case l1d_misses:
+          attr.type = PERF_TYPE_HW_CACHE;
+          attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+          break;
+
+        case llc_misses:
+          attr.type = PERF_TYPE_HARDWARE;
+          attr.config = PERF_COUNT_HW_CACHE_MISSES;
+          break;
+
+        default:
+          attr.type = PERF_TYPE_HARDWARE;
+          attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+          break;
+      } // end switch
+
+      // this thread, on any cpu
+      return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+#else
+      return -1;
+#endif
+    } // end open()
+
+    int m_fds[num_events];
+}; // end hardware_counters
+
+// counts the calls of the global operator new
+// nothing is counted unless the program replaces operator new with one which
+// calls allocations::note(), as bench.cpp does
+struct allocations
+{
+  inline static std::atomic<std::uint64_t> &count(void)
+  {
+    static std::atomic<std::uint64_t> result(0);
+    return result;
+  } // end count()
+
+  inline static std::atomic<std::uint64_t> &bytes(void)
+  {
+    static std::atomic<std::uint64_t> result(0);
+    return result;
+  } // end bytes()
+
+  inline static void note(const std::size_t n)
+  {
+    count().fetch_add(1, std::memory_order_relaxed);
+    bytes().fetch_add(n, std::memory_order_relaxed);
+  } // end note()
+}; // end allocations
+
+} // end benchmark
@@ -0,0 +1,264 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <memory>
+#include "unification.hpp"
+#include "syntax.hpp"
+#include "parser.hpp"
+#include "dependencies.hpp"
+#include "inference.hpp"
+
+namespace inference
+{
+
+// checks a stream of top-level declarations while it is still being read
+//
+// one thread parses declarations into a bounded queue while the caller's
+// thread infers them in order, so that parsing overlaps with inference. the
+// types of each declaration's bindings are generalized into the environment
+// of the declarations which follow it
+//
+// each declaration's tree is destroyed once it has been checked. nothing is
+// non-generic between top-level declarations, so once a declaration's types
+// have been resolved into the environment every binding of the substitution
+// is dead, and compact() discards it. now and then compact() also renumbers
+// variables densely, so that ids don't grow with the stream either. memory
+// is bounded by the largest declaration and the environment rather than by
+// the length of the stream
+//
+// after an error, run() doesn't wait for the parser thread, which may be
+// blocked reading an interactive stream; it is detached, and exits once its
+// current read returns. so the stream must outlive it, as std::cin does
+class declaration_pipeline
+{
+  public:
+    // called with the name and generalized type of each binding, in order
+    typedef std::function<void(const std::string &, const type &)> callback;
+
+    // if p is given, the cost of each declaration is attributed to its bindings
+    inline declaration_pipeline(std::istream &is,
+                                const environment &env,
+                                const std::size_t capacity = 64,
+                                profiler *p = 0)
+      : m_is(is),
+        m_inferencer(env, 0, 0, 0, 0, p),
+        m_capacity(std::max<std::size_t>(capacity, 1)),
+        m_renumber_at(0)
+    {}
+
+    // checks every declaration in the stream
+    // returns the number of declarations checked
+    // rethrows the first parse or type error, after which the environment
+    // holds the declarations which preceded it
+    inline std::size_t run(const callback &report)
+    {
+      // the parser thread shares the queue, which outlives run() if the
+      // thread is detached
+      auto q = std::make_shared<queue>(m_capacity);
+      std::thread parser_thread(&declaration_pipeline::parse, std::ref(m_is), q);
+
+      std::size_t result = 0;
+
+      try
+      {
+        item i;
+        while(q->pop(i))
+        {
+          check(i.m_declaration, report);
+          ++result;
+
+          // free the tree before waiting for the next one
+          i = item();
+        } // end while
+      } // end try
+      catch(...)
+      {
+        q->stop();
+        parser_thread.detach();
+        throw;
+      } // end catch
+
+      parser_thread.join();
+      return result;
+    } // end run()
+
+    // the prelude extended with every declaration checked so far
+    inline const environment &env(void) const
+    {
+      return m_inferencer.m_environment;
+    } // end env()
+
+  private:
+    struct item
+    {
+      syntax::declaration m_declaration;
+      std::exception_ptr  m_error;
+      bool                m_end;
+
+      inline item()
+        : m_end(false)
+      {}
+    }; // end item
+
+    // a bounded queue of parsed declarations
+    struct queue
+    {
+      inline queue(const std::size_t capacity)
+        : m_capacity(capacity),
+          m_stopping(false)
+      {}
+
+      // returns false if the pipeline is stopping
+      inline bool push(item &&i)
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_not_full.wait(lock, [this]{ return m_stopping || m_items.size() < m_capacity; });
+
+        if(m_stopping)
+        {
+          return false;
+        } // end if
+
+        m_items.push_back(std::move(i));
+        m_not_empty.notify_one();
+        return true;
+      } // end push()
+
+      // returns false at the end of the stream
+      inline bool pop(item &i)
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_not_empty.wait(lock, [this]{ return !m_items.empty(); });
+
+        i = std::move(m_items.front());
+        m_items.pop_front();
+        m_not_full.notify_one();
+
+        if(i.m_error)
+        {
+          std::rethrow_exception(i.m_error);
+        } // end if
+
+        return !i.m_end;
+      } // end pop()
+
+      inline void stop(void)
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+        m_not_full.notify_all();
+      } // end stop()
+
+      std::size_t             m_capacity;
+      std::mutex              m_mutex;
+      std::condition_variable m_not_empty;
+      std::condition_variable m_not_full;
+      std::deque<item>        m_items;
+      bool                    m_stopping;
+    }; // end queue
+
+    // runs on the parser thread
+    inline static void parse(std::istream &is, std::shared_ptr<queue> q)
+    {
+      syntax::parser p(is);
+
+      while(true)
+      {
+        item i;
+
+        try
+        {
+          i.m_end = p.at_end();
+          if(!i.m_end)
+          {
+            i.m_declaration = p.parse_declaration();
+          } // end if
+        } // end try
+        catch(...)
+        {
+          i.m_error = std::current_exception();
+        } // end catch
+
+        bool last = i.m_end || i.m_error;
+        if(!q->push(std::move(i)) || last)
+        {
+          return;
+        } // end if
+      } // end while
+    } // end parse()
+
+    inline void check(const syntax::declaration &d, const callback &report)
+    {
+      auto &bindings = d.m_bindings;
+
+      if(!d.m_recursive)
+      {
+        type t;
+        {
+          profiler::scope frame(m_inferencer.m_profiler);
+          if(m_inferencer.m_profiler)
+          {
+            frame.enter("let", bindings[0].first);
+          } // end if
+
+          t = m_inferencer(bindings[0].second);
+        }
+
+        publish(bindings, std::vector<std::size_t>(1, 0), std::vector<type>(1, t), report);
+        return;
+      } // end if
+
+      auto graph = syntax::analyze_dependencies(bindings);
+      for(auto component = graph.m_components.begin();
+          component != graph.m_components.end();
+          ++component)
+      {
+        auto types = m_inferencer.infer_component(bindings, *component);
+        publish(bindings, *component, std::vector<type>(types.begin(), types.end()), report);
+      } // end for component
+    } // end check()
+
+    // generalizes the given members of bindings into the environment
+    inline void publish(const std::vector<syntax::letrec_group::binding> &bindings,
+                        const std::vector<std::size_t> &members,
+                        std::vector<type> types,
+                        const callback &report)
+    {
+      std::vector<std::string> names;
+      for(std::size_t i = 0; i < members.size(); ++i)
+      {
+        names.push_back(bindings[members[i]].first);
+        m_inferencer.m_environment[names.back()] = types[i];
+      } // end for i
+
+      // renumbering renames the whole environment, so it waits until several
+      // times as many variables have been made since the last time as the
+      // environment has bindings
+      auto &env = m_inferencer.m_environment;
+      bool renumber = env.next_id() >= m_renumber_at;
+      m_inferencer.compact(names, renumber);
+      if(renumber)
+      {
+        m_renumber_at = env.next_id() + std::max<std::size_t>(4 * env.size(), 4096);
+      } // end if
+
+      for(auto name = names.begin(); name != names.end(); ++name)
+      {
+        report(*name, env.find(*name)->second);
+      } // end for name
+    } // end publish()
+
+    std::istream           &m_is;
+    inferencer              m_inferencer;
+    std::size_t             m_capacity;
+    std::size_t             m_renumber_at;
+}; // end declaration_pipeline
+
+} // end inference
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "unification.hpp"
+#include "inference.hpp"
+
+namespace inference
+{
+
+// returns an environment with the builtins used by the examples:
+//
+//   pair  : a -> b -> (a * b)
+//   true  : bool
+//   cond  : bool -> c -> c -> c
+//   zero  : int -> bool
+//   pred  : int -> int
+//   times : int -> int -> int
+inline environment prelude(void)
+{
+  environment env;
+
+  auto var1 = type_variable(env.unique_id());
+  auto var2 = type_variable(env.unique_id());
+  auto var3 = type_variable(env.unique_id());
+
+  env["pair"] = make_function(var1, make_function(var2, pair(var1, var2)));
+  env["true"] = boolean();
+  env["cond"] = make_function(
+                 boolean(),
+                  make_function(
+                    var3, make_function(
+                      var3, var3
+                    )
+                  )
+                );
+  env["zero"] = make_function(integer(), boolean());
+  env["pred"] = make_function(integer(), integer());
+  env["times"] = make_function(
+                   integer(), make_function(
+                     integer(), integer()
+                   )
+                 );
+
+  return env;
+}
+
+} // end inference
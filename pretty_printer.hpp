@@ -0,0 +1,273 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include "unification.hpp"
+#include "inference.hpp"
+
+// pretty_printer prints types with the names and notation recorded in
+// inference::constructors()
+//
+// let-polymorphism can produce types which are exponentially larger than
+// the program which produced them, but such types contain few distinct
+// subterms. so before printing, the printer folds a type into a dag of its
+// distinct subterms, and every compound subterm which is used more than once
+// is printed a single time as an abbreviation:
+//
+//   ((t1 * t1) * (t1 * t1)) where t1 = (a * a)
+class pretty_printer
+{
+  public:
+    inline pretty_printer(std::ostream &os)
+      : m_os(os),
+        m_next_abbreviation(1)
+    {}
+
+    inline pretty_printer &operator<<(const unification::type &x)
+    {
+      dag d;
+      auto root = d.insert(x);
+
+      // print the type, then define each abbreviation introduced along the way
+      std::vector<std::size_t> pending;
+      print(d, root, pending);
+
+      for(std::size_t i = 0; i < pending.size(); ++i)
+      {
+        m_os << (i ? ", " : " where ");
+        print_abbreviation(d.m_nodes[pending[i]].m_abbreviation);
+        m_os << " = ";
+        print_structure(d, pending[i], pending);
+      } // end for i
+
+      return *this;
+    }
+
+    inline pretty_printer &operator<<(std::ostream & (*fp)(std::ostream &))
+    {
+      fp(m_os);
+      return *this;
+    }
+
+    template<typename T>
+    inline pretty_printer &operator<<(const T &x)
+    {
+      m_os << x;
+      return *this;
+    }
+
+  private:
+    // a type with each distinct subterm stored once
+    struct dag
+    {
+      struct node
+      {
+        inline node(const bool is_variable,
+                    const std::size_t label)
+          : m_is_variable(is_variable),
+            m_label(label),
+            m_uses(0),
+            m_abbreviation(0)
+        {}
+
+        bool                     m_is_variable;
+        // the variable's id or the operator's kind
+        std::size_t              m_label;
+        std::vector<std::size_t> m_children;
+        // the number of edges into this node
+        std::size_t              m_uses;
+        std::size_t              m_abbreviation;
+      }; // end node
+
+      // returns the index of x's node
+      inline std::size_t insert(const unification::type &x)
+      {
+        std::vector<std::size_t> key;
+
+        if(auto var = boost::get<unification::type_variable>(&x))
+        {
+          key.push_back(0);
+          key.push_back(var->id());
+        } // end if
+        else
+        {
+          auto &op = boost::get<unification::type_operator>(x);
+          key.push_back(1);
+          key.push_back(op.kind());
+          for(auto i = op.begin();
+              i != op.end();
+              ++i)
+          {
+            key.push_back(insert(*i));
+          } // end for i
+        } // end else
+
+        auto iter = m_index.find(key);
+        if(iter != m_index.end())
+        {
+          return iter->second;
+        } // end if
+
+        // this subterm is new, so it contributes an edge to each of its children
+        std::size_t result = m_nodes.size();
+        m_nodes.push_back(node(key[0] == 0, key[1]));
+        m_nodes.back().m_children.assign(key.begin() + 2, key.end());
+
+        for(auto i = key.begin() + 2;
+            i != key.end();
+            ++i)
+        {
+          ++m_nodes[*i].m_uses;
+        } // end for i
+
+        m_index.insert(std::make_pair(std::move(key), result));
+
+        return result;
+      } // end insert()
+
+      std::vector<node>                               m_nodes;
+      std::map<std::vector<std::size_t>, std::size_t> m_index;
+    }; // end dag
+
+    inline void print(dag &d, const std::size_t i, std::vector<std::size_t> &pending)
+    {
+      auto &n = d.m_nodes[i];
+
+      if(!n.m_is_variable && !n.m_children.empty() && n.m_uses > 1)
+      {
+        if(!n.m_abbreviation)
+        {
+          n.m_abbreviation = m_next_abbreviation++;
+          pending.push_back(i);
+        } // end if
+
+        print_abbreviation(n.m_abbreviation);
+      } // end if
+      else
+      {
+        print_structure(d, i, pending);
+      } // end else
+    } // end print()
+
+    inline void print_structure(dag &d, const std::size_t i, std::vector<std::size_t> &pending)
+    {
+      if(d.m_nodes[i].m_is_variable)
+      {
+        print_variable(d.m_nodes[i].m_label);
+        return;
+      } // end if
+
+      auto &constructors = inference::constructors();
+      auto kind = d.m_nodes[i].m_label;
+
+      auto &children = d.m_nodes[i].m_children;
+
+      if(unification::row_registry::is_record(kind))
+      {
+        print_record(d, i, pending);
+      } // end if
+      else if(children.empty())
+      {
+        m_os << constructors.name(kind);
+      } // end else if
+      else if(constructors.infix(kind))
+      {
+        m_os << "(";
+        print(d, children[0], pending);
+        m_os << " " << constructors.name(kind) << " ";
+        print(d, children[1], pending);
+        m_os << ")";
+      } // end else if
+      else
+      {
+        m_os << "(" << constructors.name(kind);
+        for(auto c = children.begin();
+            c != children.end();
+            ++c)
+        {
+          m_os << " ";
+          print(d, *c, pending);
+        } // end for c
+        m_os << ")";
+      } // end else
+    } // end print_structure()
+
+    // prints {a : int, b : bool | r}, omitting the row of a closed record
+    inline void print_record(dag &d, const std::size_t i, std::vector<std::size_t> &pending)
+    {
+      auto &labels = unification::rows().labels(d.m_nodes[i].m_label);
+      auto &children = d.m_nodes[i].m_children;
+
+      m_os << "{";
+      for(std::size_t l = 0; l < labels.size(); ++l)
+      {
+        m_os << (l ? ", " : "") << unification::rows().name(labels[l]) << " : ";
+        print(d, children[l], pending);
+      } // end for l
+
+      if(!labels.empty())
+      {
+        auto &row = d.m_nodes[children.back()];
+        if(row.m_is_variable || row.m_label != unification::row_registry::empty())
+        {
+          m_os << " | ";
+          print(d, children.back(), pending);
+        } // end if
+      } // end if
+
+      m_os << "}";
+    } // end print_record()
+
+    inline void print_variable(const std::size_t id)
+    {
+      auto iter = m_names.find(id);
+      if(iter == m_names.end())
+      {
+        iter = m_names.insert(std::make_pair(id, m_names.size())).first;
+      } // end if
+
+      print_name(iter->second);
+    } // end print_variable()
+
+    // names variables a, b, ..., z, aa, ab, ...
+    inline void print_name(const std::size_t n)
+    {
+      if(n >= 26)
+      {
+        print_name(n / 26 - 1);
+      } // end if
+
+      m_os << static_cast<char>('a' + n % 26);
+    } // end print_name()
+
+    // abbreviations contain a digit, so they never collide with variable names
+    inline void print_abbreviation(const std::size_t n)
+    {
+      m_os << "t" << n;
+    } // end print_abbreviation()
+
+    std::ostream &m_os;
+
+    std::map<std::size_t, std::size_t> m_names;
+    std::size_t m_next_abbreviation;
+};
+
+namespace unification
+{
+
+inline std::ostream &operator<<(std::ostream &os, const type_variable &x)
+{
+  pretty_printer pp(os);
+  pp << type(x);
+  return os;
+}
+
+inline std::ostream &operator<<(std::ostream &os, const type_operator &x)
+{
+  pretty_printer pp(os);
+  pp << type(x);
+  return os;
+}
+
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <iostream>
+#include "unification.hpp"
+
+namespace inference
+{
+
+// a profiler attributes the cost of inference to the bindings and identifier
+// uses in which it is spent
+//
+// the inferencer enter()s a frame for the definition of each let and letrec
+// binding and for the instantiation of each identifier, so each cost is
+// charged to the path of frames from the root to where it was spent. the
+// costs are those of the profiler's counters(), which a profiled inferencer
+// charges in place of any other budget, and wall time
+//
+// write() emits the collapsed stacks read by flamegraph.pl and similar tools
+//
+//   root;let main;letrec go;use pair 1200
+class profiler
+{
+  public:
+    enum metric
+    {
+      // nanoseconds
+      wall_time,
+      unify_iterations,
+      fresh_variables,
+      type_nodes,
+      num_metrics
+    }; // end metric
+
+    typedef std::chrono::steady_clock clock;
+
+    inline profiler(const std::string &root = "infer")
+      : m_path(root),
+        m_last_time(clock::now())
+    {
+      for(int i = 0; i < num_metrics; ++i)
+      {
+        m_last[i] = 0;
+      } // end for i
+    } // end profiler()
+
+    // the counters inference charges while it is profiled
+    // limits set here apply to profiled inference
+    inline unification::budget &counters(void)
+    {
+      return m_counters;
+    } // end counters()
+
+    // charges the cost since the last frame was entered or left to the
+    // current path, and then enters the frame "kind name"
+    inline void enter(const char *kind, const std::string &name)
+    {
+      sample();
+      m_lengths.push_back(m_path.size());
+      m_path += ';';
+      m_path += kind;
+      m_path += ' ';
+      m_path += name;
+    } // end enter()
+
+    inline void leave(void)
+    {
+      sample();
+      m_path.resize(m_lengths.back());
+      m_lengths.pop_back();
+    } // end leave()
+
+    // writes one line for each path with a nonzero cost in m
+    inline void write(std::ostream &os, const metric m)
+    {
+      sample();
+
+      for(auto i = m_costs.begin();
+          i != m_costs.end();
+          ++i)
+      {
+        if(i->second.m_values[m])
+        {
+          os << i->first << " " << i->second.m_values[m] << "\n";
+        } // end if
+      } // end for i
+    } // end write()
+
+    inline static const char *name(const metric m)
+    {
+      static const char *names[] = {"wall_time", "unify_iterations", "fresh_variables", "type_nodes"};
+      return names[m];
+    } // end name()
+
+    // leaves the frame, if one was entered, at the end of the scope
+    class scope
+    {
+      public:
+        inline scope(profiler *p)
+          : m_profiler(p),
+            m_entered(false)
+        {}
+
+        inline void enter(const char *kind, const std::string &name)
+        {
+          m_profiler->enter(kind, name);
+          m_entered = true;
+        } // end enter()
+
+        inline ~scope()
+        {
+          if(m_entered)
+          {
+            m_profiler->leave();
+          } // end if
+        } // end ~scope()
+
+      private:
+        scope(const scope &);
+        scope &operator=(const scope &);
+
+        profiler *m_profiler;
+        bool      m_entered;
+    }; // end scope
+
+  private:
+    struct cost
+    {
+      inline cost()
+      {
+        for(int i = 0; i < num_metrics; ++i)
+        {
+          m_values[i] = 0;
+        } // end for i
+      } // end cost()
+
+      std::size_t m_values[num_metrics];
+    }; // end cost
+
+    inline void sample(void)
+    {
+      using unification::budget;
+
+      auto now = clock::now();
+
+      std::size_t values[num_metrics];
+      values[wall_time]        = std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_last_time).count();
+      values[unify_iterations] = m_counters.used(budget::unify_iterations);
+      values[fresh_variables]  = m_counters.used(budget::fresh_variables);
+      values[type_nodes]       = m_counters.used(budget::type_nodes);
+
+      auto &c = m_costs[m_path];
+      c.m_values[wall_time] += values[wall_time];
+      for(int i = wall_time + 1; i < num_metrics; ++i)
+      {
+        c.m_values[i] += values[i] - m_last[i];
+        m_last[i] = values[i];
+      } // end for i
+
+      m_last_time = now;
+    } // end sample()
+
+    unification::budget                m_counters;
+    std::string                        m_path;
+    std::vector<std::size_t>           m_lengths;
+    std::map<std::string, cost>        m_costs;
+    clock::time_point                  m_last_time;
+    std::size_t                        m_last[num_metrics];
+}; // end profiler
+
+} // end inference
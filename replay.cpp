@@ -0,0 +1,118 @@
+#include <fstream>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include "unification.hpp"
+#include "trace.hpp"
+
+// replays a trace recorded with demo --trace through the unifier
+//
+//   $ ./replay [--workspace] trace [repetitions]
+//
+// --workspace replays through a unification::workspace, as the inferencer
+// does, instead of solving each call's substitution again from scratch
+int main(int argc, char **argv)
+{
+  using namespace unification;
+
+  const char *program = argv[0];
+  bool use_workspace = argc > 1 && std::strcmp(argv[1], "--workspace") == 0;
+  if(use_workspace)
+  {
+    --argc;
+    ++argv;
+  } // end if
+
+  if(argc < 2)
+  {
+    std::cerr << "usage: " << program << " [--workspace] trace [repetitions]" << std::endl;
+    return 1;
+  } // end if
+
+  std::size_t repetitions = argc > 2 ? std::strtoul(argv[2], 0, 10) : 1;
+
+  // read the whole trace up front so that only unification is timed
+  // each call is tagged with the inference which made it
+  std::vector<std::pair<std::size_t, std::vector<constraint>>> calls;
+  std::size_t num_constraints = 0;
+  try
+  {
+    std::ifstream is(argv[1], std::ios::binary);
+    if(!is)
+    {
+      std::cerr << "couldn't open " << argv[1] << std::endl;
+      return 1;
+    } // end if
+
+    trace_reader reader(is);
+    std::vector<constraint> call;
+    while(reader.next(call))
+    {
+      num_constraints += call.size();
+      calls.push_back(std::make_pair(reader.inference(), call));
+    } // end while
+  } // end try
+  catch(const bad_trace &e)
+  {
+    std::cerr << argv[1] << ": " << e.what() << std::endl;
+    return 1;
+  } // end catch
+
+  std::size_t failures = 0;
+  workspace w;
+  auto start = std::chrono::steady_clock::now();
+
+  for(std::size_t r = 0; r < repetitions; ++r)
+  {
+    substitution_map substitution;
+    std::size_t inference = 0;
+
+    for(auto i = calls.begin();
+        i != calls.end();
+        ++i)
+    {
+      // calls of one inference share a substitution, as they did when recorded
+      if(i->first != inference)
+      {
+        substitution.clear();
+        inference = i->first;
+      } // end if
+
+      try
+      {
+        if(use_workspace)
+        {
+          w.unify(i->second.begin(), i->second.end(), substitution);
+        } // end if
+        else
+        {
+          detail::unifier u(i->second.begin(), i->second.end(), substitution);
+          u();
+        } // end else
+      } // end try
+      catch(const type_mismatch &)
+      {
+        ++failures;
+      } // end catch
+      catch(const recursive_unification &)
+      {
+        ++failures;
+      } // end catch
+    } // end for i
+  } // end for r
+
+  auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  auto total_calls = calls.size() * repetitions;
+
+  std::cout << "calls:       " << calls.size() << std::endl;
+  std::cout << "constraints: " << num_constraints << std::endl;
+  std::cout << "repetitions: " << repetitions << std::endl;
+  std::cout << "failures:    " << failures / (repetitions ? repetitions : 1) << std::endl;
+  std::cout << "seconds:     " << elapsed << std::endl;
+  if(total_calls)
+  {
+    std::cout << "ns per call: " << 1e9 * elapsed / total_calls << std::endl;
+  } // end if
+
+  return 0;
+}
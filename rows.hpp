@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include <shared_mutex>
+
+namespace unification
+{
+
+// a record type {l1 : t1, ..., ln : tn | r} is a type_operator whose kind
+// stands for its set of labels. its arguments are the types of its fields,
+// sorted by label, followed by its row r, which is either a type_variable or
+// the empty row {} which closes the record. so two records whose labels
+// are the same unify field by field, and two whose labels differ unify in
+// one merge of their sorted labels
+//
+// the kinds of records are numbered from row_registry::first_kind, apart from
+// the kinds of inference::constructor_registry, in order of first use. so,
+// unlike other kinds, they are private to a process
+typedef std::size_t label;
+
+// the row_registry interns labels and the kinds of records
+// it may be used from several threads at once
+class row_registry
+{
+  public:
+    static const std::size_t first_kind = std::size_t(1) << 32;
+
+    inline row_registry()
+    {
+      // the empty set of labels is the kind of the empty row
+      m_labels.push_back(std::vector<label>());
+      m_kinds[std::vector<label>()] = first_kind;
+    } // end row_registry()
+
+    // returns the label named name
+    inline label intern(const std::string &name)
+    {
+      {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        auto iter = m_label_ids.find(name);
+        if(iter != m_label_ids.end())
+        {
+          return iter->second;
+        } // end if
+      }
+
+      std::unique_lock<std::shared_mutex> lock(m_mutex);
+      auto result = m_label_ids.insert(std::make_pair(name, m_label_names.size()));
+      if(result.second)
+      {
+        m_label_names.push_back(name);
+      } // end if
+
+      return result.first->second;
+    } // end intern()
+
+    inline const std::string &name(const label l) const
+    {
+      std::shared_lock<std::shared_mutex> lock(m_mutex);
+      return m_label_names[l];
+    } // end name()
+
+    // returns the kind of records with exactly the given labels, which must
+    // be sorted and distinct
+    inline std::size_t kind(const std::vector<label> &labels)
+    {
+      {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        auto iter = m_kinds.find(labels);
+        if(iter != m_kinds.end())
+        {
+          return iter->second;
+        } // end if
+      }
+
+      std::unique_lock<std::shared_mutex> lock(m_mutex);
+      auto result = m_kinds.insert(std::make_pair(labels, first_kind + m_labels.size()));
+      if(result.second)
+      {
+        m_labels.push_back(labels);
+      } // end if
+
+      return result.first->second;
+    } // end kind()
+
+    inline static bool is_record(const std::size_t kind)
+    {
+      return kind >= first_kind;
+    } // end is_record()
+
+    // the kind of the empty row
+    inline static std::size_t empty(void)
+    {
+      return first_kind;
+    } // end empty()
+
+    // returns the sorted labels of a record kind
+    inline const std::vector<label> &labels(const std::size_t kind) const
+    {
+      std::shared_lock<std::shared_mutex> lock(m_mutex);
+      return m_labels[kind - first_kind];
+    } // end labels()
+
+  private:
+    mutable std::shared_mutex                  m_mutex;
+    std::deque<std::string>                    m_label_names;
+    std::unordered_map<std::string, label>     m_label_ids;
+    // elements of a deque stay put as it grows, so references to them
+    // remain valid outside the lock
+    std::deque<std::vector<label>>             m_labels;
+    std::map<std::vector<label>, std::size_t>  m_kinds;
+}; // end row_registry
+
+inline row_registry &rows(void)
+{
+  static row_registry result;
+  return result;
+} // end rows()
+
+} // end unification
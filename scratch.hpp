@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+#include <memory_resource>
+
+namespace unification
+{
+
+// types and the containers of the unifier and the inferencer allocate their
+// memory from the current thread's memory resource, which by default is the
+// global heap. a query may make a std::pmr::monotonic_buffer_resource current
+// for its duration so that its scratch memory is released all at once rather
+// than freed piece by piece under contention for malloc
+
+// returns the memory resource from which this thread currently allocates
+inline std::pmr::memory_resource *&current_resource(void)
+{
+  static thread_local std::pmr::memory_resource *result = std::pmr::new_delete_resource();
+  return result;
+} // end current_resource()
+
+// makes a resource current for the lifetime of the scope
+class scoped_resource
+{
+  public:
+    inline scoped_resource(std::pmr::memory_resource &resource)
+      : m_previous(current_resource())
+    {
+      current_resource() = &resource;
+    } // end scoped_resource()
+
+    inline ~scoped_resource()
+    {
+      current_resource() = m_previous;
+    } // end ~scoped_resource()
+
+    inline std::pmr::memory_resource &previous(void) const
+    {
+      return *m_previous;
+    } // end previous()
+
+  private:
+    scoped_resource(const scoped_resource &);
+    scoped_resource &operator=(const scoped_resource &);
+
+    std::pmr::memory_resource *m_previous;
+};
+
+// returns this thread's arena, a monotonic resource whose first block is
+// reused by each query after release()
+inline std::pmr::monotonic_buffer_resource &thread_arena(void)
+{
+  static const std::size_t first_block_size = 1 << 20;
+  static thread_local std::vector<char> first_block(first_block_size);
+  static thread_local std::pmr::monotonic_buffer_resource result(first_block.data(), first_block.size(), std::pmr::new_delete_resource());
+  return result;
+} // end thread_arena()
+
+namespace detail
+{
+
+// blocks from the global heap, the common case, are allocated with plain
+// operator new and have no header. a block from any other resource begins
+// with a header recording the resource it came from, so that it is returned
+// there even if it is freed while another is current
+//
+// operator new aligns every block to at least 16 bytes, and a header is 8
+// bytes placed at a 16-byte boundary, so the blocks which follow a header, and
+// only those, lie 8 bytes past a multiple of 16. scratch memory is therefore
+// aligned only to 8 bytes
+static const std::size_t scratch_alignment = sizeof(std::pmr::memory_resource*);
+static const std::size_t scratch_header_size = scratch_alignment;
+
+static_assert(__STDCPP_DEFAULT_NEW_ALIGNMENT__ >= 2 * scratch_alignment, "scratch: operator new must align to 16 bytes");
+
+inline bool is_global_heap(const std::pmr::memory_resource *resource)
+{
+  static const std::pmr::memory_resource *heap = std::pmr::new_delete_resource();
+  return resource == heap;
+} // end is_global_heap()
+
+inline void *scratch_allocate(const std::size_t n)
+{
+  auto resource = current_resource();
+  if(is_global_heap(resource))
+  {
+    return ::operator new(n);
+  } // end if
+
+  char *block = static_cast<char*>(resource->allocate(scratch_header_size + n, 2 * scratch_alignment));
+  *reinterpret_cast<std::pmr::memory_resource**>(block) = resource;
+  return block + scratch_header_size;
+} // end scratch_allocate()
+
+inline void scratch_deallocate(void *p, const std::size_t n)
+{
+  if(reinterpret_cast<std::uintptr_t>(p) % (2 * scratch_alignment) == 0)
+  {
+    ::operator delete(p);
+    return;
+  } // end if
+
+  char *block = static_cast<char*>(p) - scratch_header_size;
+  auto resource = *reinterpret_cast<std::pmr::memory_resource**>(block);
+  resource->deallocate(block, scratch_header_size + n, 2 * scratch_alignment);
+} // end scratch_deallocate()
+
+} // end detail
+
+// allocates from the current resource
+// every scratch_allocator is equal to every other, so containers may
+// exchange their memory freely
+template<typename T>
+  class scratch_allocator
+{
+  public:
+    typedef T value_type;
+
+    inline scratch_allocator() {}
+
+    template<typename U>
+      inline scratch_allocator(const scratch_allocator<U> &) {}
+
+    inline T *allocate(const std::size_t n)
+    {
+      static_assert(alignof(T) <= detail::scratch_alignment, "scratch_allocator: overaligned type");
+      return static_cast<T*>(detail::scratch_allocate(n * sizeof(T)));
+    } // end allocate()
+
+    inline void deallocate(T *p, const std::size_t n)
+    {
+      detail::scratch_deallocate(p, n * sizeof(T));
+    } // end deallocate()
+
+    template<typename U>
+      inline bool operator==(const scratch_allocator<U> &) const
+    {
+      return true;
+    } // end operator==()
+
+    template<typename U>
+      inline bool operator!=(const scratch_allocator<U> &) const
+    {
+      return false;
+    } // end operator!=()
+};
+
+} // end unification
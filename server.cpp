@@ -0,0 +1,378 @@
+#include <string>
+#include <sstream>
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "unification.hpp"
+#include "syntax.hpp"
+#include "parser.hpp"
+#include "inference.hpp"
+#include "prelude.hpp"
+#include "pretty_printer.hpp"
+
+// answers queries against a resident prelude
+//
+// each line of input is either an expression in the syntax printed by
+// syntax.hpp, which is answered with its type or an error, or :stats, which
+// is answered with latency and throughput counters
+//
+//   $ ./server                          # serve stdin
+//   $ ./server --socket path [threads]  # serve a unix socket
+//
+// each query is charged to a budget of --steps nodes visited (default
+// 1000000) and --timeout milliseconds (default 1000), and one which exceeds
+// either is answered with "error: budget exhausted"
+//
+//   $ ./server --steps 10000 --timeout 100 --socket path
+
+class thread_pool
+{
+  public:
+    inline thread_pool(const std::size_t num_threads)
+      : m_stopping(false)
+    {
+      for(std::size_t i = 0; i < num_threads; ++i)
+      {
+        m_threads.push_back(std::thread(&thread_pool::work, this));
+      } // end for i
+    } // end thread_pool()
+
+    inline ~thread_pool()
+    {
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+      }
+
+      m_wake.notify_all();
+
+      for(auto i = m_threads.begin();
+          i != m_threads.end();
+          ++i)
+      {
+        i->join();
+      } // end for i
+    } // end ~thread_pool()
+
+    inline void submit(std::function<void()> task)
+    {
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push(std::move(task));
+      }
+
+      m_wake.notify_one();
+    } // end submit()
+
+  private:
+    inline void work(void)
+    {
+      while(true)
+      {
+        std::function<void()> task;
+
+        {
+          std::unique_lock<std::mutex> lock(m_mutex);
+          m_wake.wait(lock, [this]{ return m_stopping || !m_tasks.empty(); });
+
+          if(m_tasks.empty())
+          {
+            return;
+          } // end if
+
+          task = std::move(m_tasks.front());
+          m_tasks.pop();
+        }
+
+        task();
+      } // end while
+    } // end work()
+
+    std::vector<std::thread>          m_threads;
+    std::queue<std::function<void()>> m_tasks;
+    std::mutex                        m_mutex;
+    std::condition_variable           m_wake;
+    bool                              m_stopping;
+};
+
+// a histogram of latencies with four buckets per power of two nanoseconds
+// recording is lock-free so that workers never contend on it
+class latency_histogram
+{
+  public:
+    static const std::size_t buckets_per_octave = 4;
+    static const std::size_t num_buckets = 48 * buckets_per_octave;
+
+    inline latency_histogram()
+      : m_start(std::chrono::steady_clock::now())
+    {
+      for(std::size_t i = 0; i < num_buckets; ++i)
+      {
+        m_counts[i] = 0;
+      } // end for i
+    } // end latency_histogram()
+
+    inline void record(const std::chrono::nanoseconds elapsed)
+    {
+      double ns = std::max<double>(1, elapsed.count());
+      std::size_t i = static_cast<std::size_t>(std::log2(ns) * buckets_per_octave);
+      ++m_counts[std::min(i, num_buckets - 1)];
+    } // end record()
+
+    inline std::size_t count(void) const
+    {
+      std::size_t result = 0;
+      for(std::size_t i = 0; i < num_buckets; ++i)
+      {
+        result += m_counts[i];
+      } // end for i
+
+      return result;
+    } // end count()
+
+    // returns an upper bound on the latency of fraction q of the requests, in microseconds
+    inline double percentile(const double q) const
+    {
+      std::size_t total = count();
+      std::size_t seen = 0;
+
+      for(std::size_t i = 0; i < num_buckets; ++i)
+      {
+        seen += m_counts[i];
+        if(total && seen >= q * total)
+        {
+          return std::pow(2.0, double(i + 1) / buckets_per_octave) / 1000;
+        } // end if
+      } // end for i
+
+      return 0;
+    } // end percentile()
+
+    inline double seconds(void) const
+    {
+      return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+    } // end seconds()
+
+  private:
+    std::atomic<std::size_t>              m_counts[num_buckets];
+    std::chrono::steady_clock::time_point m_start;
+};
+
+class server
+{
+  public:
+    inline server(const std::size_t steps, const std::chrono::milliseconds timeout)
+      : m_prelude(inference::prelude()),
+        m_steps(steps),
+        m_timeout(timeout)
+    {}
+
+    // returns the response to one line of input
+    inline std::string respond(const std::string &line)
+    {
+      std::ostringstream os;
+
+      if(line == ":stats")
+      {
+        auto n = m_latencies.count();
+        os << "requests " << n
+           << ", p50 " << m_latencies.percentile(0.5) << " us"
+           << ", p99 " << m_latencies.percentile(0.99) << " us"
+           << ", throughput " << n / m_latencies.seconds() << " per second";
+        return os.str();
+      } // end if
+
+      auto start = std::chrono::steady_clock::now();
+
+      unification::budget b;
+      b.limit(unification::budget::steps, m_steps).deadline(start + m_timeout);
+
+      pretty_printer pp(os);
+      try
+      {
+        auto program = syntax::parse(line);
+
+        // the prelude is only ever read, so every thread shares it in place
+        // each query's scratch memory comes from its thread's arena
+        auto result = unification::with_resource(unification::thread_arena(), [&]
+        {
+          return inference::infer_type(program, m_prelude, b);
+        });
+
+        if(result)
+        {
+          pp << result.m_type;
+        } // end if
+        else
+        {
+          pp << "error: budget exhausted: " << result.m_reason;
+        } // end else
+      } // end try
+      catch(const unification::recursive_unification &e)
+      {
+        pp << "error: " << e.what() << ": " << e.x << " in " << e.y;
+      } // end catch
+      catch(const unification::type_mismatch &e)
+      {
+        pp << "error: " << e.what() << ": " << e.x << " != " << e.y;
+      } // end catch
+      catch(const std::exception &e)
+      {
+        // no request may bring the server down
+        pp << "error: " << e.what();
+      } // end catch
+
+      unification::thread_arena().release();
+      m_latencies.record(std::chrono::steady_clock::now() - start);
+
+      return os.str();
+    } // end respond()
+
+    // serves a connected socket until the client hangs up
+    inline void serve(const int fd)
+    {
+      std::string pending;
+      char buffer[4096];
+      ssize_t n = 0;
+
+      while((n = read(fd, buffer, sizeof(buffer))) > 0)
+      {
+        pending.append(buffer, n);
+
+        std::size_t newline = 0;
+        while((newline = pending.find('\n')) != std::string::npos)
+        {
+          auto response = respond(pending.substr(0, newline)) + "\n";
+          pending.erase(0, newline + 1);
+
+          if(!write_all(fd, response))
+          {
+            close(fd);
+            return;
+          } // end if
+        } // end while
+      } // end while
+
+      close(fd);
+    } // end serve()
+
+  private:
+    inline static bool write_all(const int fd, const std::string &s)
+    {
+      for(std::size_t written = 0; written < s.size(); )
+      {
+        ssize_t n = write(fd, s.data() + written, s.size() - written);
+        if(n < 0 && errno != EINTR)
+        {
+          return false;
+        } // end if
+
+        written += std::max<ssize_t>(n, 0);
+      } // end for
+
+      return true;
+    } // end write_all()
+
+    const inference::environment     m_prelude;
+    const std::size_t                m_steps;
+    const std::chrono::milliseconds  m_timeout;
+    latency_histogram                m_latencies;
+};
+
+int serve_socket(server &s, const char *path, const std::size_t num_threads)
+{
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+
+  sockaddr_un address;
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  std::strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+  unlink(path);
+
+  if(listener < 0 ||
+     bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+     listen(listener, 64) < 0)
+  {
+    std::cerr << "couldn't listen on " << path << ": " << std::strerror(errno) << std::endl;
+    return 1;
+  } // end if
+
+  thread_pool pool(num_threads);
+
+  while(true)
+  {
+    int client = accept(listener, 0, 0);
+    if(client < 0)
+    {
+      if(errno == EINTR) continue;
+
+      std::cerr << "accept: " << std::strerror(errno) << std::endl;
+      break;
+    } // end if
+
+    pool.submit([&s, client]{ s.serve(client); });
+  } // end while
+
+  close(listener);
+  return 1;
+}
+
+int main(int argc, char **argv)
+{
+  // a client which hangs up shouldn't bring down the server
+  std::signal(SIGPIPE, SIG_IGN);
+
+  const char *program = argv[0];
+  std::size_t steps = 1000000;
+  std::chrono::milliseconds timeout(1000);
+
+  while(argc > 2 && (!std::strcmp(argv[1], "--steps") || !std::strcmp(argv[1], "--timeout")))
+  {
+    auto n = std::strtoull(argv[2], 0, 10);
+    if(!std::strcmp(argv[1], "--steps"))
+    {
+      steps = n;
+    } // end if
+    else
+    {
+      timeout = std::chrono::milliseconds(n);
+    } // end else
+
+    argc -= 2;
+    argv += 2;
+  } // end while
+
+  server s(steps, timeout);
+
+  if(argc > 2 && !std::strcmp(argv[1], "--socket"))
+  {
+    std::size_t num_threads = argc > 3 ? std::strtoul(argv[3], 0, 10) : std::thread::hardware_concurrency();
+    return serve_socket(s, argv[2], std::max<std::size_t>(num_threads, 1));
+  } // end if
+  else if(argc > 1)
+  {
+    std::cerr << "usage: " << program << " [--steps n] [--timeout ms] [--socket path [threads]]" << std::endl;
+    return 1;
+  } // end else if
+
+  std::string line;
+  while(std::getline(std::cin, line))
+  {
+    std::cout << s.respond(line) << std::endl;
+  } // end while
+
+  return 0;
+}
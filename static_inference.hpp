@@ -0,0 +1,550 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include "unification.hpp"
+#include "inference.hpp"
+#include "static_syntax.hpp"
+
+namespace static_inference
+{
+
+// types of a statically declared environment
+// variable<N> names the N-th variable of one declaration's scheme
+template<std::size_t Id>
+  struct variable {};
+
+struct integer {};
+
+struct boolean {};
+
+template<typename Argument, typename Result>
+  struct function {};
+
+template<typename First, typename Second>
+  struct pair {};
+
+template<const char *Name, typename Type>
+  struct declaration {};
+
+template<typename... Declarations>
+  struct environment {};
+
+namespace names
+{
+
+inline constexpr char pair[]  = "pair";
+inline constexpr char true_[] = "true";
+inline constexpr char cond[]  = "cond";
+inline constexpr char zero[]  = "zero";
+inline constexpr char pred[]  = "pred";
+inline constexpr char times[] = "times";
+
+} // end names
+
+// the static counterpart of inference::prelude()
+typedef environment<
+  declaration<names::pair,  function<variable<0>, function<variable<1>, pair<variable<0>, variable<1>>>>>,
+  declaration<names::true_, boolean>,
+  declaration<names::cond,  function<boolean, function<variable<0>, function<variable<0>, variable<0>>>>>,
+  declaration<names::zero,  function<integer, boolean>>,
+  declaration<names::pred,  function<integer, integer>>,
+  declaration<names::times, function<integer, function<integer, integer>>>
+> prelude;
+
+enum class error
+{
+  none,
+  undefined_symbol,
+  type_mismatch,
+  recursive_unification,
+  out_of_space
+};
+
+namespace detail
+{
+
+inline constexpr bool equal(const char *x, const char *y)
+{
+  for(; *x && *x == *y; ++x, ++y)
+    ;
+
+  return *x == *y;
+} // end equal()
+
+static const int variable_kind = -1;
+
+// the variables of one declaration are numbered below this
+static const std::size_t max_scheme_variables = 16;
+
+inline constexpr int arity(const int kind)
+{
+  return kind == inference::types::function || kind == inference::types::pair ? 2 : 0;
+} // end arity()
+
+struct type_node
+{
+  int kind         = variable_kind;
+  int arguments[2] = {0, 0};
+}; // end type_node
+
+struct scope
+{
+  const char *name    = nullptr;
+  int         type    = 0;
+  bool        generic = false;
+}; // end scope
+
+// the state of inferring one tree, mirroring inference::inferencer with
+// fixed-size arrays so that it may be evaluated as a constant expression
+//
+// a variable is identified by the index of its node, and is bound to the
+// node binding[index] - 1, if any. as with the inferencer's, the substitution
+// is triangular
+template<std::size_t NumTypes, std::size_t NumScopes>
+  struct state
+{
+  type_node   types[NumTypes]   = {};
+  int         binding[NumTypes] = {};
+  int         num_types         = 0;
+
+  // instantiate() maps each generic variable it meets to image[] once per
+  // call, as recorded by stamp[]
+  int         stamp[NumTypes]   = {};
+  int         image[NumTypes]   = {};
+  int         generation        = 0;
+
+  scope       scopes[NumScopes] = {};
+  int         num_scopes        = 0;
+
+  error       failure           = error::none;
+  int         result            = 0;
+
+  constexpr void fail(const error e)
+  {
+    if(failure == error::none)
+    {
+      failure = e;
+    } // end if
+  } // end fail()
+
+  constexpr int make_variable(void)
+  {
+    return make_operator(variable_kind);
+  } // end make_variable()
+
+  constexpr int make_operator(const int kind, const int first = 0, const int second = 0)
+  {
+    if(num_types == int(NumTypes))
+    {
+      fail(error::out_of_space);
+      return 0;
+    } // end if
+
+    types[num_types].kind = kind;
+    types[num_types].arguments[0] = first;
+    types[num_types].arguments[1] = second;
+    return num_types++;
+  } // end make_operator()
+
+  // follows the bindings of variables from t
+  constexpr int find(int t) const
+  {
+    while(types[t].kind == variable_kind && binding[t])
+    {
+      t = binding[t] - 1;
+    } // end while
+
+    return t;
+  } // end find()
+
+  constexpr bool occurs(const int var, int t) const
+  {
+    t = find(t);
+    if(types[t].kind == variable_kind)
+    {
+      return t == var;
+    } // end if
+
+    for(int i = 0; i < arity(types[t].kind); ++i)
+    {
+      if(occurs(var, types[t].arguments[i])) return true;
+    } // end for i
+
+    return false;
+  } // end occurs()
+
+  constexpr void unify(int x, int y)
+  {
+    if(failure != error::none) return;
+
+    x = find(x);
+    y = find(y);
+    if(x == y) return;
+
+    if(types[y].kind == variable_kind)
+    {
+      int swap = x;
+      x = y;
+      y = swap;
+    } // end if
+
+    if(types[x].kind == variable_kind)
+    {
+      if(occurs(x, y))
+      {
+        fail(error::recursive_unification);
+        return;
+      } // end if
+
+      binding[x] = y + 1;
+      return;
+    } // end if
+
+    if(types[x].kind != types[y].kind)
+    {
+      fail(error::type_mismatch);
+      return;
+    } // end if
+
+    for(int i = 0; i < arity(types[x].kind); ++i)
+    {
+      unify(types[x].arguments[i], types[y].arguments[i]);
+    } // end for i
+  } // end unify()
+
+  constexpr bool is_generic(const int var) const
+  {
+    for(int i = 0; i < num_scopes; ++i)
+    {
+      if(!scopes[i].generic && occurs(var, scopes[i].type)) return false;
+    } // end for i
+
+    return true;
+  } // end is_generic()
+
+  // copies t, replacing each generic variable with a fresh one
+  constexpr int instantiate(const int t)
+  {
+    ++generation;
+    return copy(t);
+  } // end instantiate()
+
+  constexpr int copy(int t)
+  {
+    t = find(t);
+    if(types[t].kind == variable_kind)
+    {
+      if(!is_generic(t)) return t;
+
+      if(stamp[t] != generation)
+      {
+        stamp[t] = generation;
+        image[t] = make_variable();
+      } // end if
+
+      return image[t];
+    } // end if
+
+    int arguments[2] = {0, 0};
+    for(int i = 0; i < arity(types[t].kind); ++i)
+    {
+      arguments[i] = copy(types[t].arguments[i]);
+    } // end for i
+
+    return make_operator(types[t].kind, arguments[0], arguments[1]);
+  } // end copy()
+
+  constexpr void push(const char *name, const int type, const bool generic)
+  {
+    if(num_scopes == int(NumScopes))
+    {
+      fail(error::out_of_space);
+      return;
+    } // end if
+
+    scopes[num_scopes].name = name;
+    scopes[num_scopes].type = type;
+    scopes[num_scopes].generic = generic;
+    ++num_scopes;
+  } // end push()
+
+  constexpr void pop(void)
+  {
+    if(num_scopes > 0)
+    {
+      --num_scopes;
+    } // end if
+  } // end pop()
+
+  constexpr int infer(const static_syntax::detail::node *nodes, const int n)
+  {
+    using static_syntax::detail::node_kind;
+
+    if(failure != error::none) return 0;
+
+    auto &node = nodes[n];
+    switch(node.kind)
+    {
+      case node_kind::identifier:
+      {
+        for(int i = num_scopes; i-- > 0; )
+        {
+          if(equal(scopes[i].name, node.name))
+          {
+            return instantiate(scopes[i].type);
+          } // end if
+        } // end for i
+
+        fail(error::undefined_symbol);
+        return 0;
+      } // end case
+
+      case node_kind::integer_literal:
+      {
+        return make_operator(inference::types::integer);
+      } // end case
+
+      case node_kind::apply:
+      {
+        int function = infer(nodes, node.children[0]);
+        int argument = infer(nodes, node.children[1]);
+        int x = make_variable();
+        unify(make_operator(inference::types::function, argument, x), function);
+        return x;
+      } // end case
+
+      case node_kind::lambda:
+      {
+        int parameter = make_variable();
+        push(node.name, parameter, false);
+        int body = infer(nodes, node.children[0]);
+        pop();
+        return make_operator(inference::types::function, parameter, body);
+      } // end case
+
+      case node_kind::let:
+      {
+        int definition = infer(nodes, node.children[0]);
+        push(node.name, definition, true);
+        int body = infer(nodes, node.children[1]);
+        pop();
+        return body;
+      } // end case
+
+      case node_kind::letrec:
+      {
+        // as in the inferencer, the name remains non-generic in the body
+        int var = make_variable();
+        push(node.name, var, false);
+        int definition = infer(nodes, node.children[0]);
+        unify(var, definition);
+        int body = infer(nodes, node.children[1]);
+        pop();
+        return body;
+      } // end case
+    } // end switch
+
+    return 0;
+  } // end infer()
+}; // end state
+
+// type_writer<T>::size is the number of nodes of T
+// type_writer<T>::write() adds T to a state, with the variables of its
+// declaration in vars
+template<typename T>
+  struct type_writer;
+
+template<std::size_t Id>
+  struct type_writer<variable<Id>>
+{
+  static_assert(Id < max_scheme_variables, "static_inference: too many variables in one declaration");
+
+  static const std::size_t size = 1;
+
+  template<typename State>
+    static constexpr int write(State &s, int *vars)
+  {
+    if(vars[Id] < 0)
+    {
+      vars[Id] = s.make_variable();
+    } // end if
+
+    return vars[Id];
+  } // end write()
+}; // end type_writer
+
+template<int Kind>
+  struct nullary_type_writer
+{
+  static const std::size_t size = 1;
+
+  template<typename State>
+    static constexpr int write(State &s, int *)
+  {
+    return s.make_operator(Kind);
+  } // end write()
+}; // end nullary_type_writer
+
+template<int Kind, typename First, typename Second>
+  struct binary_type_writer
+{
+  static const std::size_t size = 1 + type_writer<First>::size + type_writer<Second>::size;
+
+  template<typename State>
+    static constexpr int write(State &s, int *vars)
+  {
+    int first = type_writer<First>::write(s, vars);
+    int second = type_writer<Second>::write(s, vars);
+    return s.make_operator(Kind, first, second);
+  } // end write()
+}; // end binary_type_writer
+
+template<>
+  struct type_writer<integer>
+    : nullary_type_writer<inference::types::integer>
+{};
+
+template<>
+  struct type_writer<boolean>
+    : nullary_type_writer<inference::types::boolean>
+{};
+
+template<typename Argument, typename Result>
+  struct type_writer<function<Argument,Result>>
+    : binary_type_writer<inference::types::function, Argument, Result>
+{};
+
+template<typename First, typename Second>
+  struct type_writer<pair<First,Second>>
+    : binary_type_writer<inference::types::pair, First, Second>
+{};
+
+template<typename Environment>
+  struct environment_writer;
+
+template<const char *... Names, typename... Types>
+  struct environment_writer<environment<declaration<Names,Types>...>>
+{
+  static const std::size_t num_declarations = sizeof...(Names);
+  static const std::size_t size = (0 + ... + type_writer<Types>::size);
+
+  template<typename State>
+    static constexpr void write(State &s)
+  {
+    (write_declaration<Names,Types>(s), ...);
+  } // end write()
+
+  template<const char *Name, typename Type, typename State>
+    static constexpr void write_declaration(State &s)
+  {
+    int vars[max_scheme_variables] = {};
+    for(auto &v : vars)
+    {
+      v = -1;
+    } // end for v
+
+    s.push(Name, type_writer<Type>::write(s, vars), true);
+  } // end write_declaration()
+}; // end environment_writer
+
+template<typename Expression, typename Environment>
+  struct default_capacity
+{
+  static const std::size_t num_nodes = static_syntax::detail::flattener<Expression>::size;
+
+  static const std::size_t num_types  = environment_writer<Environment>::size + 16 * num_nodes;
+  static const std::size_t num_scopes = environment_writer<Environment>::num_declarations + num_nodes;
+}; // end default_capacity
+
+template<typename Expression, typename Environment, std::size_t NumTypes, std::size_t NumScopes>
+  constexpr state<NumTypes, NumScopes> infer(void)
+{
+  using static_syntax::detail::flattener;
+
+  static_syntax::detail::node nodes[flattener<Expression>::size] = {};
+  int next = 0;
+  int root = flattener<Expression>::write(nodes, next);
+
+  state<NumTypes, NumScopes> result;
+  environment_writer<Environment>::write(result);
+  result.result = result.infer(nodes, root);
+  return result;
+} // end infer()
+
+} // end detail
+
+// the principal type of Expression in Environment, computed by the compiler
+// an expression which fails to type check fails to compile
+//
+//   typedef static_syntax::lambda<x, static_syntax::identifier<x>> identity;
+//   unification::type t = static_inference::principal_type<identity>::value();
+//
+// NumTypes bounds the number of type nodes inference may create, and may be
+// raised for an expression which instantiates large schemes
+template<typename Expression,
+         typename Environment = prelude,
+         std::size_t NumTypes = detail::default_capacity<Expression,Environment>::num_types>
+  struct principal_type
+{
+  static constexpr auto state = detail::infer<Expression, Environment, NumTypes, detail::default_capacity<Expression,Environment>::num_scopes>();
+
+  static_assert(state.failure != error::undefined_symbol,      "static_inference: undefined symbol");
+  static_assert(state.failure != error::type_mismatch,         "static_inference: type mismatch");
+  static_assert(state.failure != error::recursive_unification, "static_inference: recursive unification");
+  static_assert(state.failure != error::out_of_space,          "static_inference: out of space; raise NumTypes");
+
+  // returns the type as a unification::type whose variables are numbered
+  // from 0 in order of appearance
+  // no inference happens at run time
+  inline static unification::type value(void)
+  {
+    std::map<int, unification::type_variable> variables;
+    return make(state.result, variables);
+  } // end value()
+
+  private:
+    inline static unification::type make(int t, std::map<int, unification::type_variable> &variables)
+    {
+      t = state.find(t);
+      auto &node = state.types[t];
+
+      switch(node.kind)
+      {
+        case detail::variable_kind:
+        {
+          auto iter = variables.find(t);
+          if(iter == variables.end())
+          {
+            iter = variables.insert(std::make_pair(t, unification::type_variable(variables.size()))).first;
+          } // end if
+
+          return iter->second;
+        } // end case
+
+        case inference::types::integer:
+        {
+          return inference::integer();
+        } // end case
+
+        case inference::types::boolean:
+        {
+          return inference::boolean();
+        } // end case
+
+        case inference::types::function:
+        {
+          auto argument = make(node.arguments[0], variables);
+          return inference::make_function(argument, make(node.arguments[1], variables));
+        } // end case
+
+        default:
+        {
+          auto first = make(node.arguments[0], variables);
+          return inference::pair(first, make(node.arguments[1], variables));
+        } // end default
+      } // end switch
+    } // end make()
+}; // end principal_type
+
+} // end static_inference
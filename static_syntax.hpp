@@ -0,0 +1,215 @@
+#pragma once
+
+#include <cstddef>
+#include "syntax.hpp"
+
+namespace static_syntax
+{
+
+// the classes below mirror those of syntax as types, so that a tree which is
+// known when the program is compiled can be typed by the compiler instead of
+// at run time (see static_inference.hpp)
+//
+// a name is a pointer to a null-terminated array with static storage duration
+//
+//   inline constexpr char x[] = "x";
+//   typedef lambda<x, identifier<x>> identity;
+
+template<const char *Name>
+  struct identifier {};
+
+template<int Value>
+  struct integer_literal {};
+
+template<typename Function, typename Argument>
+  struct apply {};
+
+template<const char *Parameter, typename Body>
+  struct lambda {};
+
+template<const char *Name, typename Definition, typename Body>
+  struct let {};
+
+template<const char *Name, typename Definition, typename Body>
+  struct letrec {};
+
+namespace detail
+{
+
+enum class node_kind
+{
+  identifier,
+  integer_literal,
+  apply,
+  lambda,
+  let,
+  letrec
+};
+
+// a node of a tree laid out in an array, which a constant expression can walk
+struct node
+{
+  node_kind   kind        = node_kind::integer_literal;
+  const char *name        = nullptr;
+  int         value       = 0;
+  int         children[2] = {0, 0};
+}; // end node
+
+// flattener<T>::size is the number of nodes of T
+// flattener<T>::write() appends them to nodes in post-order and returns the
+// index of the root
+template<typename T>
+  struct flattener;
+
+template<const char *Name>
+  struct flattener<identifier<Name>>
+{
+  static const std::size_t size = 1;
+
+  static constexpr int write(node *nodes, int &next)
+  {
+    nodes[next].kind = node_kind::identifier;
+    nodes[next].name = Name;
+    return next++;
+  } // end write()
+}; // end flattener
+
+template<int Value>
+  struct flattener<integer_literal<Value>>
+{
+  static const std::size_t size = 1;
+
+  static constexpr int write(node *nodes, int &next)
+  {
+    nodes[next].kind = node_kind::integer_literal;
+    nodes[next].value = Value;
+    return next++;
+  } // end write()
+}; // end flattener
+
+template<typename Function, typename Argument>
+  struct flattener<apply<Function,Argument>>
+{
+  static const std::size_t size = 1 + flattener<Function>::size + flattener<Argument>::size;
+
+  static constexpr int write(node *nodes, int &next)
+  {
+    int function = flattener<Function>::write(nodes, next);
+    int argument = flattener<Argument>::write(nodes, next);
+    nodes[next].kind = node_kind::apply;
+    nodes[next].children[0] = function;
+    nodes[next].children[1] = argument;
+    return next++;
+  } // end write()
+}; // end flattener
+
+template<const char *Parameter, typename Body>
+  struct flattener<lambda<Parameter,Body>>
+{
+  static const std::size_t size = 1 + flattener<Body>::size;
+
+  static constexpr int write(node *nodes, int &next)
+  {
+    int body = flattener<Body>::write(nodes, next);
+    nodes[next].kind = node_kind::lambda;
+    nodes[next].name = Parameter;
+    nodes[next].children[0] = body;
+    return next++;
+  } // end write()
+}; // end flattener
+
+template<node_kind Kind, const char *Name, typename Definition, typename Body>
+  struct binding_flattener
+{
+  static const std::size_t size = 1 + flattener<Definition>::size + flattener<Body>::size;
+
+  static constexpr int write(node *nodes, int &next)
+  {
+    int definition = flattener<Definition>::write(nodes, next);
+    int body = flattener<Body>::write(nodes, next);
+    nodes[next].kind = Kind;
+    nodes[next].name = Name;
+    nodes[next].children[0] = definition;
+    nodes[next].children[1] = body;
+    return next++;
+  } // end write()
+}; // end binding_flattener
+
+template<const char *Name, typename Definition, typename Body>
+  struct flattener<let<Name,Definition,Body>>
+    : binding_flattener<node_kind::let, Name, Definition, Body>
+{};
+
+template<const char *Name, typename Definition, typename Body>
+  struct flattener<letrec<Name,Definition,Body>>
+    : binding_flattener<node_kind::letrec, Name, Definition, Body>
+{};
+
+// node_maker<T>::make() returns the syntax::node T describes
+template<typename T>
+  struct node_maker;
+
+template<const char *Name>
+  struct node_maker<identifier<Name>>
+{
+  static syntax::node make(void)
+  {
+    return syntax::identifier(Name);
+  } // end make()
+}; // end node_maker
+
+template<int Value>
+  struct node_maker<integer_literal<Value>>
+{
+  static syntax::node make(void)
+  {
+    return syntax::integer_literal(Value);
+  } // end make()
+}; // end node_maker
+
+template<typename Function, typename Argument>
+  struct node_maker<apply<Function,Argument>>
+{
+  static syntax::node make(void)
+  {
+    return syntax::apply(node_maker<Function>::make(), node_maker<Argument>::make());
+  } // end make()
+}; // end node_maker
+
+template<const char *Parameter, typename Body>
+  struct node_maker<lambda<Parameter,Body>>
+{
+  static syntax::node make(void)
+  {
+    return syntax::lambda(Parameter, node_maker<Body>::make());
+  } // end make()
+}; // end node_maker
+
+template<const char *Name, typename Definition, typename Body>
+  struct node_maker<let<Name,Definition,Body>>
+{
+  static syntax::node make(void)
+  {
+    return syntax::let(Name, node_maker<Definition>::make(), node_maker<Body>::make());
+  } // end make()
+}; // end node_maker
+
+template<const char *Name, typename Definition, typename Body>
+  struct node_maker<letrec<Name,Definition,Body>>
+{
+  static syntax::node make(void)
+  {
+    return syntax::letrec(Name, node_maker<Definition>::make(), node_maker<Body>::make());
+  } // end make()
+}; // end node_maker
+
+} // end detail
+
+// returns the syntax::node described by Expression
+template<typename Expression>
+  inline syntax::node to_node(void)
+{
+  return detail::node_maker<Expression>::make();
+} // end to_node()
+
+} // end static_syntax
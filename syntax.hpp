@@ -1,6 +1,8 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include <utility>
 #include <iostream>
 #include <boost/variant.hpp>
 
@@ -54,6 +56,9 @@ class apply;
 class lambda;
 class let;
 class letrec;
+class letrec_group;
+class record;
+class selection;
 
 typedef boost::variant<
   integer_literal,
@@ -61,7 +66,10 @@ typedef boost::variant<
   boost::recursive_wrapper<apply>,
   boost::recursive_wrapper<lambda>,
   boost::recursive_wrapper<let>,
-  boost::recursive_wrapper<letrec>
+  boost::recursive_wrapper<letrec>,
+  boost::recursive_wrapper<letrec_group>,
+  boost::recursive_wrapper<record>,
+  boost::recursive_wrapper<selection>
 > node;
 
 class apply
@@ -221,5 +229,217 @@ inline std::ostream &operator<<(std::ostream &os, const letrec &l)
   return os << "(letrec " << l.name() << " = " << l.definition() << " in " << l.body() << ")";
 }
 
-} // end syntax
+// binds several mutually recursive names at once
+class letrec_group
+{
+  public:
+    typedef std::pair<std::string, node> binding;
+
+    inline letrec_group(std::vector<binding> &&bindings,
+                        node &&body)
+      : m_bindings(std::move(bindings)),
+        m_body(std::move(body))
+    {}
+
+    inline letrec_group(const std::vector<binding> &bindings,
+                        const node &body)
+      : m_bindings(bindings),
+        m_body(body)
+    {}
+
+    inline const std::vector<binding> &bindings() const
+    {
+      return m_bindings;
+    }
+
+    inline const node &body() const
+    {
+      return m_body;
+    }
+
+  private:
+    std::vector<binding> m_bindings;
+    node m_body;
+};
+
+inline std::ostream &operator<<(std::ostream &os, const letrec_group &l)
+{
+  os << "(letrec ";
+  for(auto i = l.bindings().begin();
+      i != l.bindings().end();
+      ++i)
+  {
+    if(i != l.bindings().begin())
+    {
+      os << " and ";
+    } // end if
+
+    os << i->first << " = " << i->second;
+  } // end for i
+
+  return os << " in " << l.body() << ")";
+}
+
+// a record of named fields, such as {x = 1, y = true}
+class record
+{
+  public:
+    typedef std::pair<std::string, node> field;
+
+    inline record(std::vector<field> &&fields)
+      : m_fields(std::move(fields))
+    {}
+
+    inline record(const std::vector<field> &fields)
+      : m_fields(fields)
+    {}
+
+    inline const std::vector<field> &fields() const
+    {
+      return m_fields;
+    }
+
+  private:
+    std::vector<field> m_fields;
+};
+
+inline std::ostream &operator<<(std::ostream &os, const record &r)
+{
+  os << "{";
+  for(auto i = r.fields().begin();
+      i != r.fields().end();
+      ++i)
+  {
+    if(i != r.fields().begin())
+    {
+      os << ", ";
+    } // end if
+
+    os << i->first << " = " << i->second;
+  } // end for i
+
+  return os << "}";
+}
+
+// selects the field named label of a record, such as r.x
+class selection
+{
+  public:
+    inline selection(node &&record,
+                     const std::string &label)
+      : m_record(std::move(record)),
+        m_label(label)
+    {}
+
+    inline selection(const node &record,
+                     const std::string &label)
+      : m_record(record),
+        m_label(label)
+    {}
+
+    inline const node &record() const
+    {
+      return m_record;
+    }
 
+    inline const std::string &label() const
+    {
+      return m_label;
+    }
+
+  private:
+    node m_record;
+    std::string m_label;
+};
+
+inline std::ostream &operator<<(std::ostream &os, const selection &s)
+{
+  return os << s.record() << "." << s.label();
+}
+
+struct address_visitor
+  : boost::static_visitor<const void*>
+{
+  template<typename T>
+    inline const void *operator()(const T &x) const
+  {
+    return &x;
+  } // end operator()()
+}; // end address_visitor
+
+// returns the address of the term held by n, which identifies n for as
+// long as the tree containing it is alive
+inline const void *address(const node &n)
+{
+  return boost::apply_visitor(address_visitor(), n);
+} // end address()
+
+struct children_visitor
+  : boost::static_visitor<std::vector<const node*>>
+{
+  inline result_type operator()(const integer_literal &) const
+  {
+    return result_type();
+  } // end operator()()
+
+  inline result_type operator()(const identifier &) const
+  {
+    return result_type();
+  } // end operator()()
+
+  inline result_type operator()(const apply &app) const
+  {
+    return result_type{&app.function(), &app.argument()};
+  } // end operator()()
+
+  inline result_type operator()(const lambda &l) const
+  {
+    return result_type{&l.body()};
+  } // end operator()()
+
+  inline result_type operator()(const let &l) const
+  {
+    return result_type{&l.definition(), &l.body()};
+  } // end operator()()
+
+  inline result_type operator()(const letrec &l) const
+  {
+    return result_type{&l.definition(), &l.body()};
+  } // end operator()()
+
+  inline result_type operator()(const letrec_group &g) const
+  {
+    result_type result;
+    for(auto i = g.bindings().begin(); i != g.bindings().end(); ++i)
+    {
+      result.push_back(&i->second);
+    } // end for i
+
+    result.push_back(&g.body());
+    return result;
+  } // end operator()()
+
+  inline result_type operator()(const record &r) const
+  {
+    result_type result;
+    for(auto i = r.fields().begin(); i != r.fields().end(); ++i)
+    {
+      result.push_back(&i->second);
+    } // end for i
+
+    return result;
+  } // end operator()()
+
+  inline result_type operator()(const selection &s) const
+  {
+    return result_type{&s.record()};
+  } // end operator()()
+}; // end children_visitor
+
+// returns the immediate subterms of n, in the order they're written
+inline std::vector<const node*> children(const node &n)
+{
+  return boost::apply_visitor(children_visitor(), n);
+} // end children()
+
+} // end syntax
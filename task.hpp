@@ -0,0 +1,190 @@
+#pragma once
+
+#include <ucontext.h>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include "unification.hpp"
+#include "syntax.hpp"
+#include "inference.hpp"
+
+namespace inference
+{
+
+struct cancelled
+  : std::runtime_error
+{
+  inline cancelled()
+    : std::runtime_error("inference cancelled")
+  {}
+};
+
+// a task is an inference which may be run a slice at a time
+//
+// each call to resume() runs the inference until it finishes or until it
+// has done the given amount of work, as measured by unification::budget, so
+// that a scheduler may interleave many tasks on one thread and abandon the
+// ones it no longer needs. the inference runs on its own stack, so it may be
+// suspended anywhere, including in the middle of the unifier
+//
+// the node and the environment must outlive the task
+class task
+{
+  public:
+    inline task(const syntax::node &n,
+                const environment &env,
+                const unification::budget &limits = unification::budget(),
+                const std::size_t stack_size = 8 << 20)
+      : m_node(n),
+        m_environment(env),
+        m_budget(limits),
+        m_state(ready),
+        m_cancelled(false),
+        m_stack(new char[stack_size]),
+        m_stack_size(stack_size)
+    {}
+
+    inline ~task()
+    {
+      cancel();
+    } // end ~task()
+
+    // runs the inference for at most quantum units of work
+    // returns true if the inference has finished
+    inline bool resume(const std::size_t quantum)
+    {
+      if(m_state == ready)
+      {
+        getcontext(&m_context);
+        m_context.uc_stack.ss_sp   = m_stack.get();
+        m_context.uc_stack.ss_size = m_stack_size;
+        m_context.uc_link          = &m_caller;
+
+        std::uintptr_t self = reinterpret_cast<std::uintptr_t>(this);
+        makecontext(&m_context, reinterpret_cast<void(*)()>(&task::start), 2,
+                    static_cast<unsigned int>(self >> 32),
+                    static_cast<unsigned int>(self));
+
+        m_state = running;
+      } // end if
+
+      if(m_state == running)
+      {
+        m_budget.every(quantum, [this]{ suspend(); });
+        swapcontext(&m_caller, &m_context);
+      } // end if
+
+      return m_state == done;
+    } // end resume()
+
+    // abandons the inference, unwinding its stack if it is suspended
+    inline void cancel(void)
+    {
+      if(m_state == running)
+      {
+        m_cancelled = true;
+        swapcontext(&m_caller, &m_context);
+      } // end if
+      else if(m_state == ready)
+      {
+        m_error = std::make_exception_ptr(cancelled());
+        m_state = done;
+      } // end else if
+    } // end cancel()
+
+    inline bool finished(void) const
+    {
+      return m_state == done;
+    } // end finished()
+
+    // returns true if the inference ran out of its budget's limits, as
+    // opposed to suspending after a quantum
+    inline bool exhausted(void) const
+    {
+      return m_outcome.m_exhausted;
+    } // end exhausted()
+
+    // returns the inferred type, or throws the inference's error
+    // a task which ran out of budget throws budget_exhausted
+    inline type result(void) const
+    {
+      if(m_state != done)
+      {
+        throw std::logic_error("task::result(): inference has not finished");
+      } // end if
+
+      if(m_error)
+      {
+        std::rethrow_exception(m_error);
+      } // end if
+
+      if(m_outcome.m_exhausted)
+      {
+        throw unification::budget_exhausted(m_outcome.m_reason);
+      } // end if
+
+      return m_outcome.m_type;
+    } // end result()
+
+    inline const unification::budget &work(void) const
+    {
+      return m_budget;
+    } // end work()
+
+  private:
+    enum state
+    {
+      ready,
+      running,
+      done
+    }; // end state
+
+    inline static void start(const unsigned int hi, const unsigned int lo)
+    {
+      std::uintptr_t self = (static_cast<std::uintptr_t>(hi) << 32) | lo;
+      reinterpret_cast<task*>(self)->run();
+
+      // returning resumes m_caller through uc_link
+    } // end start()
+
+    inline void run(void)
+    {
+      try
+      {
+        m_outcome = infer_type(m_node, m_environment, m_budget);
+      } // end try
+      catch(...)
+      {
+        m_error = std::current_exception();
+      } // end catch
+
+      m_state = done;
+    } // end run()
+
+    // called on the task's stack by the budget
+    inline void suspend(void)
+    {
+      swapcontext(&m_context, &m_caller);
+
+      if(m_cancelled)
+      {
+        // unwind the inference's stack
+        throw cancelled();
+      } // end if
+    } // end suspend()
+
+    const syntax::node       &m_node;
+    const environment        &m_environment;
+    unification::budget       m_budget;
+    state                     m_state;
+    bool                      m_cancelled;
+    budgeted_type             m_outcome;
+    std::exception_ptr        m_error;
+    std::unique_ptr<char[]>   m_stack;
+    std::size_t               m_stack_size;
+    ucontext_t                m_context;
+    ucontext_t                m_caller;
+}; // end task
+
+} // end inference
@@ -0,0 +1,337 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include "unification.hpp"
+
+namespace unification
+{
+
+// a trace records the constraints of a sequence of calls to unify() so that
+// they may be replayed through the unifier in isolation
+//
+// the format is the magic string "hmtrace3" followed by a sequence of records.
+// each inference begins with an 'i' record, and the calls to unify() it makes
+// share a substitution, which starts out empty:
+//
+//   record := 'i'
+//           | 'u' varint(number of constraints) (type type)*
+//   type   := 'v' varint(id)                             -- a type_variable
+//           | 'o' varint(kind) varint(arity) type*       -- a type_operator
+//           | 'r' varint(n) (label type)* type           -- a record
+//   label  := varint(length) byte*
+//
+// the kinds of records are private to a process, so a record is written as
+// its labels, the types of its fields and its row. the empty row is a record
+// with no fields and no row
+//
+// varints are little-endian base 128. a type's tag is a byte of its own,
+// rather than bits of its first varint, so that ids as large as a row
+// variable's are written whole
+//
+// a type which nests more deeply than max_type_depth is a bad trace, rather
+// than an overflow of the stack of read_type()
+static const std::size_t max_type_depth = 1 << 12;
+struct bad_trace
+  : std::runtime_error
+{
+  inline bad_trace(const std::string &what)
+    : std::runtime_error("bad trace: " + what)
+  {}
+};
+
+namespace detail
+{
+
+inline void write_varint(std::ostream &os, std::size_t x)
+{
+  while(x >= 0x80)
+  {
+    os.put(static_cast<char>((x & 0x7f) | 0x80));
+    x >>= 7;
+  } // end while
+
+  os.put(static_cast<char>(x));
+} // end write_varint()
+
+inline std::size_t read_varint(std::istream &is)
+{
+  std::size_t result = 0;
+
+  for(unsigned int shift = 0; shift < 64; shift += 7)
+  {
+    int c = is.get();
+    if(c == std::char_traits<char>::eof())
+    {
+      throw bad_trace("unexpected end of file");
+    } // end if
+
+    result |= static_cast<std::size_t>(c & 0x7f) << shift;
+
+    if(!(c & 0x80))
+    {
+      return result;
+    } // end if
+  } // end for shift
+
+  throw bad_trace("varint too long");
+} // end read_varint()
+
+// throws bad_trace unless n items, each of at least one byte, can remain in
+// is, so that a damaged count is never used to size a container
+// the end of is is sought only when its buffer holds fewer than n bytes, and
+// a stream which can't seek, like a pipe, is trusted
+inline std::size_t check_count(std::istream &is, const std::size_t n)
+{
+  std::streamsize buffered = is.rdbuf()->in_avail();
+  if(buffered >= 0 && n <= static_cast<std::size_t>(buffered))
+  {
+    return n;
+  } // end if
+
+  auto here = is.tellg();
+  if(here == std::istream::pos_type(-1))
+  {
+    is.clear();
+    return n;
+  } // end if
+
+  is.seekg(0, std::ios::end);
+  auto end = is.tellg();
+  is.seekg(here);
+
+  if(end != std::istream::pos_type(-1) && n > static_cast<std::size_t>(end - here))
+  {
+    throw bad_trace("count exceeds the bytes left");
+  } // end if
+
+  return n;
+} // end check_count()
+
+inline std::size_t read_count(std::istream &is)
+{
+  return check_count(is, read_varint(is));
+} // end read_count()
+
+} // end detail
+
+inline void write_type(std::ostream &os, const type &x)
+{
+  if(auto var = boost::get<type_variable>(&x))
+  {
+    os.put('v');
+    detail::write_varint(os, var->id());
+  } // end if
+  else if(is_record(boost::get<type_operator>(x)))
+  {
+    auto &op = boost::get<type_operator>(x);
+    auto &labels = rows().labels(op.kind());
+    os.put('r');
+    detail::write_varint(os, labels.size());
+
+    for(std::size_t i = 0; i < labels.size(); ++i)
+    {
+      auto &name = rows().name(labels[i]);
+      detail::write_varint(os, name.size());
+      os.write(name.data(), name.size());
+      write_type(os, op[i]);
+    } // end for i
+
+    if(!labels.empty())
+    {
+      write_type(os, op[labels.size()]);
+    } // end if
+  } // end else if
+  else
+  {
+    auto &op = boost::get<type_operator>(x);
+    os.put('o');
+    detail::write_varint(os, op.kind());
+    detail::write_varint(os, op.size());
+
+    for(auto i = op.begin();
+        i != op.end();
+        ++i)
+    {
+      write_type(os, *i);
+    } // end for i
+  } // end else
+} // end write_type()
+
+// depth counts the types which enclose the one being read
+inline type read_type(std::istream &is, const std::size_t depth = 0)
+{
+  if(depth == max_type_depth)
+  {
+    throw bad_trace("type nested too deeply");
+  } // end if
+
+  int tag = is.get();
+
+  if(tag == 'v')
+  {
+    return type_variable(detail::read_varint(is));
+  } // end if
+
+  if(tag == 'r')
+  {
+    // labels are interned anew, so the fields are sorted again
+    field_vector fields(detail::read_count(is));
+    for(auto i = fields.begin();
+        i != fields.end();
+        ++i)
+    {
+      std::string name(detail::read_count(is), '\0');
+      if(!is.read(&name[0], name.size()))
+      {
+        throw bad_trace("unexpected end of file");
+      } // end if
+
+      i->first = rows().intern(name);
+      i->second = read_type(is, depth + 1);
+    } // end for i
+
+    if(fields.empty())
+    {
+      return empty_row();
+    } // end if
+
+    std::sort(fields.begin(), fields.end(), detail::by_label);
+    for(std::size_t i = 1; i < fields.size(); ++i)
+    {
+      if(fields[i-1].first == fields[i].first)
+      {
+        throw bad_trace("repeated label");
+      } // end if
+    } // end for i
+
+    return make_record(fields, read_type(is, depth + 1));
+  } // end if
+
+  if(tag == std::char_traits<char>::eof())
+  {
+    throw bad_trace("unexpected end of file");
+  } // end if
+
+  if(tag != 'o')
+  {
+    throw bad_trace("bad type");
+  } // end if
+
+  std::size_t kind = detail::read_varint(is);
+  if(row_registry::is_record(kind))
+  {
+    throw bad_trace("bad type");
+  } // end if
+
+  type_vector types(detail::read_count(is));
+  for(auto i = types.begin();
+      i != types.end();
+      ++i)
+  {
+    *i = read_type(is, depth + 1);
+  } // end for i
+
+  return type_operator(kind, std::move(types));
+} // end read_type()
+
+class trace_writer
+{
+  public:
+    inline trace_writer(std::ostream &os)
+      : m_os(os)
+    {
+      m_os.write("hmtrace3", 8);
+    } // end trace_writer()
+
+    // marks the beginning of a new inference with an empty substitution
+    inline void begin(void)
+    {
+      m_os.put('i');
+    } // end begin()
+
+    template<typename Iterator>
+      inline void record(Iterator first_constraint, Iterator last_constraint)
+    {
+      m_os.put('u');
+      detail::write_varint(m_os, std::distance(first_constraint, last_constraint));
+
+      for(; first_constraint != last_constraint; ++first_constraint)
+      {
+        write_type(m_os, first_constraint->first);
+        write_type(m_os, first_constraint->second);
+      } // end for
+    } // end record()
+
+    inline void record(const type &x, const type &y)
+    {
+      auto c = constraint(x,y);
+      record(&c, &c + 1);
+    } // end record()
+
+  private:
+    std::ostream &m_os;
+}; // end trace_writer
+
+class trace_reader
+{
+  public:
+    inline trace_reader(std::istream &is)
+      : m_is(is),
+        m_inference(0)
+    {
+      char magic[8];
+      if(!m_is.read(magic, 8) || std::string(magic, 8) != "hmtrace3")
+      {
+        throw bad_trace("missing magic");
+      } // end if
+    } // end trace_reader()
+
+    // reads the constraints of the next call into call
+    // returns false at the end of the trace
+    inline bool next(std::vector<constraint> &call)
+    {
+      int c = m_is.get();
+      for(; c == 'i'; c = m_is.get())
+      {
+        ++m_inference;
+      } // end for
+
+      if(c == std::char_traits<char>::eof())
+      {
+        return false;
+      } // end if
+
+      if(c != 'u')
+      {
+        throw bad_trace("expected a call");
+      } // end if
+
+      call.clear();
+      call.resize(detail::read_count(m_is));
+      for(auto i = call.begin();
+          i != call.end();
+          ++i)
+      {
+        i->first  = read_type(m_is);
+        i->second = read_type(m_is);
+      } // end for i
+
+      return true;
+    } // end next()
+
+    // returns the number of inferences begun so far; calls with the same
+    // number share a substitution
+    inline std::size_t inference(void) const
+    {
+      return m_inference;
+    } // end inference()
+
+  private:
+    std::istream &m_is;
+    std::size_t   m_inference;
+}; // end trace_reader
+
+} // end unification
@@ -0,0 +1,370 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <memory_resource>
+#include <stdexcept>
+#include <iostream>
+#include <boost/variant.hpp>
+#include "syntax.hpp"
+#include "evaluator.hpp"
+
+namespace evaluation
+{
+
+// a naive interpreter which walks the syntax tree, against which the
+// bytecode machine is measured
+//
+// every value is boxed and tagged, variables are looked up by name in a
+// linked list of bindings, and builtins are applied one argument at a time
+// through partial applications. like the machine, it treats a saturated
+// cond as a branch
+class tree_walker
+{
+  public:
+    struct value;
+
+    struct scope
+    {
+      const std::string *m_name;
+      const value       *m_value;
+      const scope       *m_next;
+    }; // end scope
+
+    struct value
+    {
+      enum tag_type
+      {
+        integer_tag,
+        boolean_tag,
+        closure_tag,
+        builtin_tag,
+        pair_tag,
+        record_tag
+      }; // end tag_type
+
+      tag_type              m_tag;
+      int                   m_integer;
+      // a closure's function and scope
+      const syntax::lambda *m_lambda;
+      const scope          *m_scope;
+      // a builtin applied to m_integer arguments, the last of which is
+      // m_second and the rest of which are applied to m_first
+      builtin_kind          m_builtin;
+      // the elements of a pair
+      const value          *m_first;
+      const value          *m_second;
+      // a record's fields, whose names are m_scope's names
+    }; // end value
+
+    inline tree_walker(void)
+      : m_depth(0)
+    {}
+
+    // the tree must outlive the values evaluate() returns
+    inline const value *evaluate(const syntax::node &n)
+    {
+      m_depth = 0;
+      return eval(n, 0);
+    } // end evaluate()
+
+    // frees every value made by previous evaluations
+    inline void reset(void)
+    {
+      m_heap.release();
+    } // end reset()
+
+    inline static void print(std::ostream &os, const value *x)
+    {
+      switch(x->m_tag)
+      {
+        case value::integer_tag:
+          os << x->m_integer;
+          break;
+
+        case value::boolean_tag:
+          os << (x->m_integer ? "true" : "false");
+          break;
+
+        case value::closure_tag:
+        case value::builtin_tag:
+          os << "<function>";
+          break;
+
+        case value::pair_tag:
+          os << "(";
+          print(os, x->m_first);
+          os << ", ";
+          print(os, x->m_second);
+          os << ")";
+          break;
+
+        case value::record_tag:
+          os << "{";
+          for(auto field = x->m_scope; field; field = field->m_next)
+          {
+            os << (field == x->m_scope ? "" : ", ") << *field->m_name << " = ";
+            print(os, field->m_value);
+          } // end for field
+          os << "}";
+          break;
+      } // end switch
+    } // end print()
+
+  private:
+    inline value *make(const value::tag_type tag)
+    {
+      auto result = new(m_heap.allocate(sizeof(value), alignof(value))) value();
+      result->m_tag = tag;
+      return result;
+    } // end make()
+
+    inline const value *integer(const int x)
+    {
+      auto result = make(value::integer_tag);
+      result->m_integer = x;
+      return result;
+    } // end integer()
+
+    inline const value *boolean(const bool x)
+    {
+      auto result = make(value::boolean_tag);
+      result->m_integer = x;
+      return result;
+    } // end boolean()
+
+    inline scope *bind(const std::string &name, const value *x, const scope *next)
+    {
+      return new(m_heap.allocate(sizeof(scope), alignof(scope))) scope{&name, x, next};
+    } // end bind()
+
+    inline static const scope *find(const scope *s, const std::string &name)
+    {
+      for(; s && *s->m_name != name; s = s->m_next)
+        ;
+
+      return s;
+    } // end find()
+
+    // evaluates each node against a scope
+    struct evaluator
+      : boost::static_visitor<const value*>
+    {
+      inline evaluator(tree_walker &w, const scope *s)
+        : m_walker(w),
+          m_scope(s)
+      {}
+
+      template<typename T>
+        inline const value *operator()(const T &x) const
+      {
+        return m_walker.eval(x, m_scope);
+      } // end operator()()
+
+      tree_walker &m_walker;
+      const scope *m_scope;
+    }; // end evaluator
+
+    inline const value *eval(const syntax::node &n, const scope *s)
+    {
+      return boost::apply_visitor(evaluator(*this, s), n);
+    } // end eval()
+
+    inline const value *eval(const syntax::integer_literal &il, const scope *)
+    {
+      return integer(il.value());
+    } // end eval()
+
+    inline const value *eval(const syntax::identifier &id, const scope *s)
+    {
+      if(auto binding = find(s, id.name()))
+      {
+        return binding->m_value;
+      } // end if
+
+      auto b = find_builtin(id.name());
+      if(b == num_builtins)
+      {
+        throw std::runtime_error("evaluation: no implementation of " + id.name());
+      } // end if
+
+      if(b == builtin_true)
+      {
+        return boolean(true);
+      } // end if
+
+      auto result = make(value::builtin_tag);
+      result->m_builtin = b;
+      result->m_integer = 0;
+      return result;
+    } // end eval()
+
+    inline const value *eval(const syntax::apply &app, const scope *s)
+    {
+      // cond c x y
+      auto inner = boost::get<syntax::apply>(&app.function());
+      auto innermost = inner ? boost::get<syntax::apply>(&inner->function()) : 0;
+      auto id = innermost ? boost::get<syntax::identifier>(&innermost->function()) : 0;
+      if(id && id->name() == builtin_name(builtin_cond) && !find(s, id->name()))
+      {
+        return eval(eval(innermost->argument(), s)->m_integer ? inner->argument() : app.argument(), s);
+      } // end if
+
+      auto f = eval(app.function(), s);
+      auto x = eval(app.argument(), s);
+      return call(f, x);
+    } // end eval()
+
+    inline const value *call(const value *f, const value *x)
+    {
+      if(f->m_tag == value::closure_tag)
+      {
+        // every call nests on the native stack, even one in tail position
+        if(m_depth == max_depth)
+        {
+          throw std::runtime_error("evaluation: the tree walker recursed too deeply");
+        } // end if
+
+        ++m_depth;
+        auto result = eval(f->m_lambda->body(), bind(f->m_lambda->parameter(), x, f->m_scope));
+        --m_depth;
+        return result;
+      } // end if
+
+      auto partial = make(value::builtin_tag);
+      partial->m_builtin = f->m_builtin;
+      partial->m_integer = f->m_integer + 1;
+      partial->m_first = f;
+      partial->m_second = x;
+
+      if(std::size_t(partial->m_integer) < builtin_arity(f->m_builtin))
+      {
+        return partial;
+      } // end if
+
+      // gather the arguments
+      std::vector<const value*> arguments(partial->m_integer);
+      for(auto p = static_cast<const value*>(partial); p->m_integer > 0; p = p->m_first)
+      {
+        arguments[p->m_integer - 1] = p->m_second;
+      } // end for p
+
+      switch(f->m_builtin)
+      {
+        case builtin_pair:
+        {
+          auto result = make(value::pair_tag);
+          result->m_first = arguments[0];
+          result->m_second = arguments[1];
+          return result;
+        } // end case
+
+        case builtin_cond:
+          return arguments[0]->m_integer ? arguments[1] : arguments[2];
+
+        case builtin_zero:
+          return boolean(arguments[0]->m_integer == 0);
+
+        case builtin_pred:
+          return integer(pred(arguments[0]->m_integer));
+
+        case builtin_times:
+          return integer(times(arguments[0]->m_integer, arguments[1]->m_integer));
+
+        default:
+          throw std::logic_error("evaluation: bad builtin");
+      } // end switch
+    } // end call()
+
+    inline const value *eval(const syntax::lambda &l, const scope *s)
+    {
+      auto result = make(value::closure_tag);
+      result->m_lambda = &l;
+      result->m_scope = s;
+      return result;
+    } // end eval()
+
+    inline const value *eval(const syntax::let &l, const scope *s)
+    {
+      return eval(l.body(), bind(l.name(), eval(l.definition(), s), s));
+    } // end eval()
+
+    typedef std::vector<std::pair<const std::string*, const syntax::node*>> recursive_bindings;
+
+    // the definitions see the scope the bindings are added to, which is
+    // completed once they have been evaluated
+    inline const scope *eval_recursive(const recursive_bindings &bindings, const scope *s)
+    {
+      std::vector<scope*> added;
+      for(auto i = bindings.begin(); i != bindings.end(); ++i)
+      {
+        added.push_back(bind(*i->first, 0, s));
+        s = added.back();
+      } // end for i
+
+      for(std::size_t i = 0; i < bindings.size(); ++i)
+      {
+        if(!boost::get<syntax::lambda>(bindings[i].second))
+        {
+          throw std::runtime_error("evaluation: letrec can only define functions, but " + *bindings[i].first + " isn't one");
+        } // end if
+
+        added[i]->m_value = eval(*bindings[i].second, s);
+      } // end for i
+
+      return s;
+    } // end eval_recursive()
+
+    inline const value *eval(const syntax::letrec &l, const scope *s)
+    {
+      return eval(l.body(), eval_recursive(recursive_bindings(1, std::make_pair(&l.name(), &l.definition())), s));
+    } // end eval()
+
+    inline const value *eval(const syntax::letrec_group &l, const scope *s)
+    {
+      recursive_bindings bindings;
+      for(auto i = l.bindings().begin(); i != l.bindings().end(); ++i)
+      {
+        bindings.push_back(std::make_pair(&i->first, &i->second));
+      } // end for i
+
+      return eval(l.body(), eval_recursive(bindings, s));
+    } // end eval()
+
+    inline const value *eval(const syntax::record &r, const scope *s)
+    {
+      // the fields are kept in order of their names
+      std::vector<std::pair<const std::string*, const value*>> fields;
+      for(auto i = r.fields().begin(); i != r.fields().end(); ++i)
+      {
+        fields.push_back(std::make_pair(&i->first, eval(i->second, s)));
+      } // end for i
+
+      std::sort(fields.begin(), fields.end(), [](const std::pair<const std::string*, const value*> &x, const std::pair<const std::string*, const value*> &y)
+      {
+        return *x.first < *y.first;
+      });
+
+      auto result = make(value::record_tag);
+      result->m_scope = 0;
+      for(auto i = fields.rbegin(); i != fields.rend(); ++i)
+      {
+        result->m_scope = bind(*i->first, i->second, result->m_scope);
+      } // end for i
+
+      return result;
+    } // end eval()
+
+    inline const value *eval(const syntax::selection &sel, const scope *s)
+    {
+      return find(eval(sel.record(), s)->m_scope, sel.label())->m_value;
+    } // end eval()
+
+    static const std::size_t max_depth = 1 << 12;
+
+    std::size_t                         m_depth;
+    std::pmr::monotonic_buffer_resource m_heap;
+}; // end tree_walker
+
+} // end evaluation
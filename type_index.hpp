@@ -0,0 +1,283 @@
+#pragma once
+
+#include <map>
+#include <vector>
+#include <string>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <algorithm>
+#include "unification.hpp"
+#include "inference.hpp"
+
+namespace inference
+{
+
+// a type_index answers "which bindings have a type which unifies with this
+// one" without unifying the query with every binding
+//
+// the index is a discrimination tree: each binding's type is written in
+// preorder as a path of symbols, one per node, and the paths share a trie.
+// a type_operator's symbol is its kind and arity, and a variable's is a
+// wildcard. a query walks the trie along its own path, and a wildcard on
+// either side skips a whole subtree of the other. only the bindings at the
+// end of a surviving path are unified with the query, by a workspace which
+// returns failure rather than throwing it
+//
+// the walk treats every variable as distinct, so that a binding like
+// a -> a survives a query like int -> bool, and records are wildcards too,
+// since records of different labels may unify. both are caught by unification
+//
+// the variables of a binding's type are generic, as those of a prelude's
+// are, so each binding is renamed apart from the query: its variables are
+// numbered from first_variable, which queries shouldn't reach
+class type_index
+{
+  public:
+    static const std::size_t first_variable = std::numeric_limits<std::size_t>::max() / 2;
+
+    inline type_index()
+      : m_root(new trie)
+    {}
+
+    inline type_index(const environment &env)
+      : m_root(new trie)
+    {
+      for(auto i = env.begin();
+          i != env.end();
+          ++i)
+      {
+        insert(i->first, i->second);
+      } // end for i
+    } // end type_index()
+
+    // indexes name's type, replacing any type it had
+    // costs time in the size of t, whatever the size of the index
+    inline void insert(const std::string &name, const type &t)
+    {
+      erase(name);
+
+      // entries may outlive whatever resource the caller has made current
+      unification::scoped_resource scope(*std::pmr::new_delete_resource());
+
+      entry e;
+      e.m_type = t;
+      std::map<type_variable,type_variable> names;
+      inferencer::rename(e.m_type, names);
+      offset_variables(e.m_type);
+
+      std::vector<symbol> path;
+      write_path(e.m_type, path);
+
+      trie *n = m_root.get();
+      for(auto i = path.begin();
+          i != path.end();
+          ++i)
+      {
+        auto &child = n->m_children[*i];
+        if(!child)
+        {
+          child.reset(new trie);
+        } // end if
+
+        n = child.get();
+      } // end for i
+
+      e.m_leaf = n;
+      n->m_names.push_back(name);
+      m_entries.insert(std::make_pair(name, std::move(e)));
+    } // end insert()
+
+    inline void erase(const std::string &name)
+    {
+      auto iter = m_entries.find(name);
+      if(iter == m_entries.end()) return;
+
+      // a path is left in the trie, however empty, to be reused
+      auto &names = iter->second.m_leaf->m_names;
+      names.erase(std::find(names.begin(), names.end(), name));
+      m_entries.erase(iter);
+    } // end erase()
+
+    inline std::size_t size(void) const
+    {
+      return m_entries.size();
+    } // end size()
+
+    // returns the names of the bindings whose paths survive the walk of
+    // query's, which are all those whose types may unify with query
+    inline std::vector<std::string> candidates(const type &query) const
+    {
+      std::vector<std::pair<symbol,std::size_t>> path;
+      write_query(query, path);
+
+      std::vector<std::string> result;
+      walk(*m_root, path, 0, result);
+      std::sort(result.begin(), result.end());
+
+      return result;
+    } // end candidates()
+
+    // returns the names, in order, of the bindings whose types unify with query
+    inline std::vector<std::string> unifiable(const type &query) const
+    {
+      std::vector<std::string> result;
+
+      unification::workspace w;
+      unification::substitution_map substitution;
+      auto survivors = candidates(query);
+      for(auto i = survivors.begin();
+          i != survivors.end();
+          ++i)
+      {
+        substitution.clear();
+        if(w.try_unify(query, m_entries.find(*i)->second.m_type, substitution))
+        {
+          result.push_back(*i);
+        } // end if
+      } // end for i
+
+      return result;
+    } // end unifiable()
+
+  private:
+    typedef type_operator::kind_type kind_type;
+
+    // a type_operator's kind and arity
+    typedef std::pair<kind_type, std::size_t> symbol;
+
+    inline static symbol wildcard(void)
+    {
+      return symbol(std::numeric_limits<kind_type>::max(), 0);
+    } // end wildcard()
+
+    struct trie
+    {
+      std::map<symbol, std::unique_ptr<trie>>  m_children;
+      std::vector<std::string>                 m_names;
+    }; // end trie
+
+    struct entry
+    {
+      type   m_type;
+      trie  *m_leaf;
+    }; // end entry
+
+    inline static void offset_variables(type &x)
+    {
+      if(auto var = boost::get<type_variable>(&x))
+      {
+        *var = type_variable(first_variable + var->id());
+        return;
+      } // end if
+
+      auto &op = boost::get<type_operator>(x);
+      for(std::size_t i = 0; i < op.size(); ++i)
+      {
+        offset_variables(op[i]);
+      } // end for i
+    } // end offset_variables()
+
+    inline static void write_path(const type &x, std::vector<symbol> &path)
+    {
+      auto op = boost::get<type_operator>(&x);
+      if(!op || unification::is_record(*op))
+      {
+        path.push_back(wildcard());
+        return;
+      } // end if
+
+      path.push_back(symbol(op->kind(), op->size()));
+      for(auto i = op->begin();
+          i != op->end();
+          ++i)
+      {
+        write_path(*i, path);
+      } // end for i
+    } // end write_path()
+
+    // each symbol of a query's path is paired with the length of the path of
+    // its subtree, so that a wildcard in the trie can skip the subtree
+    inline static void write_query(const type &x, std::vector<std::pair<symbol,std::size_t>> &path)
+    {
+      auto first = path.size();
+
+      auto op = boost::get<type_operator>(&x);
+      if(!op || unification::is_record(*op))
+      {
+        path.push_back(std::make_pair(wildcard(), 1));
+        return;
+      } // end if
+
+      path.push_back(std::make_pair(symbol(op->kind(), op->size()), 0));
+      for(auto i = op->begin();
+          i != op->end();
+          ++i)
+      {
+        write_query(*i, path);
+      } // end for i
+
+      path[first].second = path.size() - first;
+    } // end write_query()
+
+    // calls f with each node reached from n by skipping the paths of
+    // num_subtrees whole subtrees
+    template<typename Function>
+      inline static void skip(const trie &n, const std::size_t num_subtrees, Function &f)
+    {
+      if(num_subtrees == 0)
+      {
+        f(n);
+        return;
+      } // end if
+
+      for(auto i = n.m_children.begin();
+          i != n.m_children.end();
+          ++i)
+      {
+        skip(*i->second, num_subtrees - 1 + i->first.second, f);
+      } // end for i
+    } // end skip()
+
+    inline static void walk(const trie &n,
+                            const std::vector<std::pair<symbol,std::size_t>> &path,
+                            const std::size_t position,
+                            std::vector<std::string> &result)
+    {
+      if(position == path.size())
+      {
+        result.insert(result.end(), n.m_names.begin(), n.m_names.end());
+        return;
+      } // end if
+
+      auto &s = path[position];
+      if(s.first == wildcard())
+      {
+        // a variable of the query matches any subtree of the trie
+        auto next = [&](const trie &m)
+        {
+          walk(m, path, position + 1, result);
+        };
+        skip(n, 1, next);
+        return;
+      } // end if
+
+      auto exact = n.m_children.find(s.first);
+      if(exact != n.m_children.end())
+      {
+        walk(*exact->second, path, position + 1, result);
+      } // end if
+
+      // a variable of a binding matches the whole subtree of the query
+      auto any = n.m_children.find(wildcard());
+      if(any != n.m_children.end())
+      {
+        walk(*any->second, path, position + s.second, result);
+      } // end if
+    } // end walk()
+
+    std::unique_ptr<trie>          m_root;
+    std::map<std::string, entry>   m_entries;
+}; // end type_index
+
+} // end inference
@@ -5,11 +5,17 @@
 #include <sstream>
 #include <vector>
 #include <map>
+#include <set>
 #include <algorithm>
 #include <functional>
 #include <stdexcept>
+#include <chrono>
+#include <limits>
+#include <atomic>
 #include <boost/variant.hpp>
 #include <boost/variant/recursive_wrapper.hpp>
+#include "scratch.hpp"
+#include "rows.hpp"
 
 namespace unification
 {
@@ -22,6 +28,9 @@ typedef boost::variant<
   boost::recursive_wrapper<type_operator>
 > type;
 
+// the arguments of a type_operator
+typedef std::vector<type, scratch_allocator<type>> type_vector;
+
 class type_variable
 {
   public:
@@ -63,13 +72,13 @@ class type_variable
 }; // end type_variable
 
 class type_operator
-  : private std::vector<type>
+  : private type_vector
 {
   public:
     typedef std::size_t kind_type;
 
   private:
-    typedef std::vector<type> super_t;
+    typedef type_vector super_t;
     std::vector<type> m_types;
 
     kind_type m_kind;
@@ -98,6 +107,18 @@ class type_operator
           m_kind(kind)
     {}
 
+    inline type_operator(const kind_type &kind,
+                         type_vector &&types)
+      : super_t(std::move(types)),
+        m_kind(kind)
+    {}
+
+    inline type_operator(const kind_type &kind,
+                         std::vector<type> &&types)
+      : super_t(std::make_move_iterator(types.begin()), std::make_move_iterator(types.end())),
+        m_kind(kind)
+    {}
+
     template<typename Range>
     inline type_operator(const kind_type &kind,
                          const Range &rng)
@@ -129,6 +150,17 @@ class type_operator
       return m_kind;
     } // end kind()
 
+    // type_operators are allocated from the current resource, like their arguments
+    inline static void *operator new(const std::size_t n)
+    {
+      return detail::scratch_allocate(n);
+    } // end operator new()
+
+    inline static void operator delete(void *p, const std::size_t n)
+    {
+      detail::scratch_deallocate(p, n);
+    } // end operator delete()
+
     inline bool compare_kind(const type_operator &other) const
     {
       return kind() == other.kind() && size() == other.size();
@@ -142,6 +174,20 @@ class type_operator
 
 typedef std::pair<type, type> constraint;
 
+// a substitution maps type variables to the types bound to them
+typedef std::map<
+  type_variable,
+  type,
+  std::less<type_variable>,
+  scratch_allocator<std::pair<const type_variable, type>>
+> substitution_map;
+
+typedef std::set<
+  type_variable,
+  std::less<type_variable>,
+  scratch_allocator<type_variable>
+> variable_set;
+
 struct type_mismatch
   : std::runtime_error
 {
@@ -173,35 +219,367 @@ struct recursive_unification
   type x, y;
 };
 
+// a field of a record type
+typedef std::pair<label, type> field;
+typedef std::vector<field, scratch_allocator<field>> field_vector;
+
+// the row which closes a record
+inline type empty_row(void)
+{
+  return type_operator(row_registry::empty());
+} // end empty_row()
+
+inline bool is_record(const type_operator &x)
+{
+  return row_registry::is_record(x.kind());
+} // end is_record()
+
+// returns the record {fields | row}, or row itself if there are no fields
+// fields must be sorted by label and distinct
+inline type make_record(const field_vector &fields, const type &row)
+{
+  if(fields.empty())
+  {
+    return row;
+  } // end if
+
+  std::vector<label> labels;
+  labels.reserve(fields.size());
+
+  type_vector types;
+  types.reserve(fields.size() + 1);
+
+  for(auto i = fields.begin();
+      i != fields.end();
+      ++i)
+  {
+    labels.push_back(i->first);
+    types.push_back(i->second);
+  } // end for i
+  types.push_back(row);
+
+  return type_operator(rows().kind(labels), std::move(types));
+} // end make_record()
+
+namespace detail
+{
+
+// returns the type at the end of the chain of variables beginning at x
+inline const type &walk(const type &x, const substitution_map &substitution)
+{
+  const type *result = &x;
+
+  while(auto var = boost::get<type_variable>(result))
+  {
+    auto iter = substitution.find(*var);
+    if(iter == substitution.end()) break;
+
+    result = &iter->second;
+  } // end while
+
+  return *result;
+} // end walk()
+
+inline bool by_label(const field &x, const field &y)
+{
+  return x.first < y.first;
+} // end by_label()
+
+// collects the fields of the record x, and of any records its row is bound
+// to through substitution, into fields sorted by label
+// returns the row which remains
+inline type record_fields(const type_operator &x, field_vector &fields, const substitution_map *substitution = 0)
+{
+  fields.clear();
+
+  const type_operator *op = &x;
+  while(true)
+  {
+    auto &labels = rows().labels(op->kind());
+    if(labels.empty())
+    {
+      return *op;
+    } // end if
+
+    auto middle = fields.size();
+    for(std::size_t i = 0; i < labels.size(); ++i)
+    {
+      fields.push_back(field(labels[i], (*op)[i]));
+    } // end for i
+    std::inplace_merge(fields.begin(), fields.begin() + middle, fields.end(), by_label);
+
+    auto &row = substitution ? walk((*op)[labels.size()], *substitution) : (*op)[labels.size()];
+    auto row_op = boost::get<type_operator>(&row);
+    if(!row_op || !is_record(*row_op))
+    {
+      return row;
+    } // end if
+
+    op = row_op;
+  } // end while
+} // end record_fields()
+
+// unifies the records x and y, whose labels differ, by one merge of their
+// sorted fields. the constraints which remain are pushed onto stack, and
+// fresh() makes the row both share if each has labels the other lacks
+// returns false if x and y cannot be unified
+template<typename Stack, typename Fresh>
+  inline bool unify_records(const type_operator &x, const type_operator &y, Stack &stack, const substitution_map *substitution, Fresh fresh)
+{
+  field_vector xs, ys;
+  type x_row = record_fields(x, xs, substitution);
+  type y_row = record_fields(y, ys, substitution);
+
+  field_vector only_x, only_y;
+  auto xi = xs.begin(), yi = ys.begin();
+  while(xi != xs.end() && yi != ys.end())
+  {
+    if(xi->first == yi->first)
+    {
+      stack.push_back(constraint(xi->second, yi->second));
+      ++xi;
+      ++yi;
+    } // end if
+    else if(xi->first < yi->first)
+    {
+      only_x.push_back(*xi++);
+    } // end else if
+    else
+    {
+      only_y.push_back(*yi++);
+    } // end else
+  } // end while
+  only_x.insert(only_x.end(), xi, xs.end());
+  only_y.insert(only_y.end(), yi, ys.end());
+
+  // a closed record cannot gain fields
+  auto x_closed = boost::get<type_operator>(&x_row);
+  auto y_closed = boost::get<type_operator>(&y_row);
+  if((x_closed && !only_y.empty()) || (y_closed && !only_x.empty()))
+  {
+    return false;
+  } // end if
+
+  if(only_x.empty())
+  {
+    stack.push_back(constraint(x_row, make_record(only_y, y_row)));
+  } // end if
+  else if(only_y.empty())
+  {
+    stack.push_back(constraint(y_row, make_record(only_x, x_row)));
+  } // end else if
+  else
+  {
+    // a row cannot hold labels which the record it ends already has
+    if(x_row == y_row)
+    {
+      return false;
+    } // end if
+
+    type row = fresh();
+    stack.push_back(constraint(x_row, make_record(only_y, row)));
+    stack.push_back(constraint(y_row, make_record(only_x, row)));
+  } // end else
+
+  return true;
+} // end unify_records()
+
+// makes the rows of a unifier which was given no other way to make
+// variables, numbering them down from the largest id so that they never
+// collide with those an environment numbers up from 0
+inline type_variable fresh_row_variable(void)
+{
+  static std::atomic<std::size_t> next(std::numeric_limits<std::size_t>::max());
+  return type_variable(next--);
+} // end fresh_row_variable()
+
+} // end detail
+
+struct budget_exhausted
+  : std::runtime_error
+{
+  inline budget_exhausted(const std::string &what)
+    : std::runtime_error("budget exhausted: " + what),
+      reason(what)
+  {}
+
+  // the limit which ran out, or "deadline"
+  std::string reason;
+};
+
+// a budget limits the work done by unification and inference
+//
+// the unifier and the inferencer charge() the budget as they work, and
+// charge() throws budget_exhausted as soon as any limit is exceeded or the
+// deadline has passed. a budget may also invoke a hook after every quantum
+// units of work, which is how inference is suspended and resumed
+class budget
+{
+  public:
+    enum resource
+    {
+      // nodes of the syntax tree visited
+      steps,
+      // constraints popped by the unifier
+      unify_iterations,
+      // type_operators constructed
+      type_nodes,
+      // type_variables created by inference
+      fresh_variables,
+      num_resources
+    }; // end resource
+
+    typedef std::chrono::steady_clock clock;
+
+    inline budget()
+      : m_deadline(clock::time_point::max()),
+        m_until_clock_check(clock_check_interval),
+        m_quantum(0),
+        m_since_hook(0)
+    {
+      for(int i = 0; i < num_resources; ++i)
+      {
+        m_limits[i] = std::numeric_limits<std::size_t>::max();
+        m_used[i] = 0;
+      } // end for i
+    } // end budget()
+
+    inline budget &limit(const resource r, const std::size_t n)
+    {
+      m_limits[r] = n;
+      return *this;
+    } // end limit()
+
+    inline budget &deadline(const clock::time_point &t)
+    {
+      m_deadline = t;
+      return *this;
+    } // end deadline()
+
+    // hook is called after every quantum units of work; quantum 0 disables it
+    inline void every(const std::size_t quantum, const std::function<void()> &hook)
+    {
+      m_quantum = quantum;
+      m_since_hook = 0;
+      m_hook = hook;
+    } // end every()
+
+    inline std::size_t used(const resource r) const
+    {
+      return m_used[r];
+    } // end used()
+
+    inline void charge(const resource r, const std::size_t n = 1)
+    {
+      m_used[r] += n;
+
+      if(m_used[r] > m_limits[r])
+      {
+        static const char *names[] = {"steps", "unify iterations", "type nodes", "fresh variables"};
+        throw budget_exhausted(names[r]);
+      } // end if
+
+      // reading the clock is expensive, so don't do it on every charge
+      if(--m_until_clock_check == 0)
+      {
+        m_until_clock_check = clock_check_interval;
+
+        if(clock::now() > m_deadline)
+        {
+          throw budget_exhausted("deadline");
+        } // end if
+      } // end if
+
+      if(m_quantum && (m_since_hook += n) >= m_quantum)
+      {
+        m_since_hook = 0;
+        m_hook();
+      } // end if
+    } // end charge()
+
+  private:
+    static const std::size_t clock_check_interval = 256;
+
+    std::size_t              m_limits[num_resources];
+    std::size_t              m_used[num_resources];
+    clock::time_point        m_deadline;
+    std::size_t              m_until_clock_check;
+    std::size_t              m_quantum;
+    std::size_t              m_since_hook;
+    std::function<void()>    m_hook;
+}; // end budget
+
 namespace detail
 {
 
-inline void replace(type &x, const type_variable &replace_me, const type &replacement)
+// returns the number of nodes in x
+inline std::size_t size(const type &x)
 {
+  std::size_t result = 1;
   if(x.which())
   {
     auto &op = boost::get<type_operator>(x);
-    auto f = std::bind(replace, std::placeholders::_1, replace_me, replacement);
-    std::for_each(op.begin(), op.end(), f);
+    for(auto i = op.begin();
+        i != op.end();
+        ++i)
+    {
+      result += size(*i);
+    } // end for i
+  } // end if
+
+  return result;
+} // end size()
+
+// if b is given, each node visited is charged as a unify iteration, and each
+// copy of replacement is charged as type nodes
+inline void replace(type &x, const type_variable &replace_me, const type &replacement, budget *b = 0)
+{
+  if(b)
+  {
+    b->charge(budget::unify_iterations);
+  } // end if
+
+  if(x.which())
+  {
+    auto &op = boost::get<type_operator>(x);
+    for(std::size_t i = 0; i < op.size(); ++i)
+    {
+      replace(op[i], replace_me, replacement, b);
+    } // end for i
   } // end if
   else
   {
     auto &var = boost::get<type_variable>(x);
     if(var == replace_me)
     {
+      if(b)
+      {
+        b->charge(budget::type_nodes, size(replacement));
+      } // end if
+
       x = replacement;
     } // end if
   } // end else
 } // end replace()
 
-inline bool occurs(const type &haystack, const type_variable &needle)
+// if b is given, each node visited is charged as a unify iteration
+inline bool occurs(const type &haystack, const type_variable &needle, budget *b = 0)
 {
+  if(b)
+  {
+    b->charge(budget::unify_iterations);
+  } // end if
+
   bool result = false;
   if(haystack.which())
   {
     auto &op = boost::get<type_operator>(haystack);
-    auto f = std::bind(occurs, std::placeholders::_1, needle);
-    result = std::any_of(op.begin(), op.end(), f);
+    for(auto i = op.begin();
+        !result && i != op.end();
+        ++i)
+    {
+      result = occurs(*i, needle, b);
+    } // end for i
   } // end end if
   else
   {
@@ -268,23 +646,24 @@ class unifier
         i != m_stack.end();
         ++i)
     {
-      replace(i->first, x, y);
-      replace(i->second, x, y);
+      replace(i->first, x, y, m_budget);
+      replace(i->second, x, y, m_budget);
     } // end for i
 
     for(auto i = m_substitution.begin();
         i != m_substitution.end();
         ++i)
     {
-      replace(i->second, x, y);
+      replace(i->second, x, y, m_budget);
     } // end for i
 
     // add x = y to the substitution
     m_substitution[x] = y;
   } // end eliminate()
 
-  std::vector<constraint>       m_stack;
-  std::map<type_variable, type> &m_substitution;
+  std::vector<constraint, scratch_allocator<constraint>> m_stack;
+  substitution_map                                       &m_substitution;
+  budget                                                 *m_budget;
 
   public:
     // apply_visitor requires that these functions be public
@@ -298,7 +677,7 @@ class unifier
 
     inline void operator()(const type_variable &x, const type_operator &y)
     {
-      if(occurs(y,x))
+      if(occurs(y,x,m_budget))
       {
         throw recursive_unification(x,y);
       } // end if
@@ -308,7 +687,7 @@ class unifier
 
     inline void operator()(const type_operator &x, const type_variable &y)
     {
-      if(occurs(x,y))
+      if(occurs(x,y,m_budget))
       {
         throw recursive_unification(y,x);
       } // end if
@@ -318,8 +697,15 @@ class unifier
 
     inline void operator()(const type_operator &x, const type_operator &y)
     {
+      // records with different labels are merged; substitution is applied
+      // eagerly, so the rows of x and y needn't be looked up
       if(!x.compare_kind(y))
       {
+        if(is_record(x) && is_record(y) && unify_records(x, y, m_stack, 0, fresh_row_variable))
+        {
+          return;
+        } // end if
+
         throw type_mismatch(x,y);
       } // end if
 
@@ -333,9 +719,10 @@ class unifier
     } // end operator()()
 
     template<typename Iterator>
-      inline unifier(Iterator first_constraint, Iterator last_constraint, std::map<type_variable,type> &substitution)
+      inline unifier(Iterator first_constraint, Iterator last_constraint, substitution_map &substitution, budget *b = 0)
         : m_stack(first_constraint, last_constraint),
-          m_substitution(substitution)
+          m_substitution(substitution),
+          m_budget(b)
     {
       // add the current substitution to the stack
       // XXX this step might be unnecessary
@@ -347,6 +734,11 @@ class unifier
     {
       while(!m_stack.empty())
       {
+        if(m_budget)
+        {
+          m_budget->charge(budget::unify_iterations);
+        } // end if
+
         type x = std::move(m_stack.back().first);
         type y = std::move(m_stack.back().second);
         m_stack.pop_back();
@@ -359,33 +751,293 @@ class unifier
 } // end detail
 
 template<typename Iterator>
-  void unify(Iterator first_constraint, Iterator last_constraint, std::map<type_variable,type> &substitution)
+  void unify(Iterator first_constraint, Iterator last_constraint, substitution_map &substitution, budget *b = 0)
 {
-  detail::unifier u(first_constraint, last_constraint, substitution);
+  detail::unifier u(first_constraint, last_constraint, substitution, b);
   u();
 } // end unify()
 
 template<typename Range>
-  void unify(const Range &rng, std::map<type_variable,type> &substitution)
+  void unify(const Range &rng, substitution_map &substitution)
 {
   return unify(rng.begin(), rng.end(), substitution);
 } // end unify()
 
 // often our system has only a single constraint
-void unify(const type &x, const type &y, std::map<type_variable,type> &substitution)
+void unify(const type &x, const type &y, substitution_map &substitution, budget *b = 0)
 {
   auto c = constraint(x,y);
-  return unify(&c, &c + 1, substitution);
+  return unify(&c, &c + 1, substitution, b);
 } // end unify()
 
+// as above, but the unifier's scratch memory and the types it adds to
+// substitution are allocated from resource
+void unify(const type &x, const type &y, substitution_map &substitution, std::pmr::memory_resource &resource, budget *b = 0)
+{
+  scoped_resource scope(resource);
+  return unify(x, y, substitution, b);
+} // end unify()
+
+// applies the substitution to every variable in x, however deeply nested
+inline type resolve(const substitution_map &substitution, const type &x)
+{
+  if(auto var = boost::get<type_variable>(&x))
+  {
+    auto iter = substitution.find(*var);
+    return iter == substitution.end() ? x : resolve(substitution, iter->second);
+  } // end if
+
+  auto &op = boost::get<type_operator>(x);
+  if(op.size() == 0)
+  {
+    return x;
+  } // end if
+
+  type_vector types;
+  types.reserve(op.size());
+  for(auto i = op.begin();
+      i != op.end();
+      ++i)
+  {
+    types.push_back(resolve(substitution, *i));
+  } // end for i
+
+  // a record whose row is bound to another record is written as one record
+  if(is_record(op))
+  {
+    auto row = boost::get<type_operator>(&types.back());
+    if(row && is_record(*row) && row->size() > 0)
+    {
+      type_operator record(op.kind(), std::move(types));
+      field_vector fields;
+      type rest = detail::record_fields(record, fields);
+      return make_record(fields, rest);
+    } // end if
+  } // end if
+
+  return type_operator(op.kind(), std::move(types));
+} // end resolve()
+
+// a workspace unifies constraints into a triangular substitution, in which
+// the type bound to a variable may mention other bound variables
+//
+// unify() above solves the whole substitution again on every call, so its
+// cost grows with the substitution. a workspace instead processes only the
+// new constraints, looking variables up in the substitution as it meets them,
+// and keeps the capacity of its stack from one call to the next
+//
+// a type drawn from a triangular substitution must be resolve()d before it is
+// shown to anyone. the types carried by type_mismatch and
+// recursive_unification already are
+class workspace
+{
+  public:
+    inline workspace(budget *b = 0)
+      : m_budget(b)
+    {}
+
+    // fresh() returns a new type_variable, which is needed to unify records
+    // when each has labels the other lacks
+    template<typename Iterator, typename Fresh = type_variable(*)(void)>
+      inline void unify(Iterator first_constraint, Iterator last_constraint, substitution_map &substitution,
+                        Fresh fresh = detail::fresh_row_variable)
+    {
+      run(first_constraint, last_constraint, substitution, fresh, true);
+    } // end unify()
+
+    template<typename Fresh = type_variable(*)(void)>
+      inline void unify(const type &x, const type &y, substitution_map &substitution,
+                        Fresh fresh = detail::fresh_row_variable)
+    {
+      auto c = constraint(x,y);
+      unify(&c, &c + 1, substitution, fresh);
+    } // end unify()
+
+    // as unify(), but returns false instead of throwing when the constraints
+    // can't be unified, for callers which expect most attempts to fail
+    // the substitution is then left partially solved
+    template<typename Iterator, typename Fresh = type_variable(*)(void)>
+      inline bool try_unify(Iterator first_constraint, Iterator last_constraint, substitution_map &substitution,
+                            Fresh fresh = detail::fresh_row_variable)
+    {
+      return run(first_constraint, last_constraint, substitution, fresh, false);
+    } // end try_unify()
+
+    template<typename Fresh = type_variable(*)(void)>
+      inline bool try_unify(const type &x, const type &y, substitution_map &substitution,
+                            Fresh fresh = detail::fresh_row_variable)
+    {
+      auto c = constraint(x,y);
+      return try_unify(&c, &c + 1, substitution, fresh);
+    } // end try_unify()
+
+    // returns the type at the end of the chain of variables beginning at x
+    inline static const type &walk(const type &x, const substitution_map &substitution)
+    {
+      return detail::walk(x, substitution);
+    } // end walk()
+
+    // returns true if needle occurs in haystack, looking through the bindings
+    // of the substitution
+    inline static bool occurs(const type &haystack, const type_variable &needle, const substitution_map &substitution, budget *b = 0)
+    {
+      if(b)
+      {
+        b->charge(budget::unify_iterations);
+      } // end if
+
+      auto &x = walk(haystack, substitution);
+
+      if(auto var = boost::get<type_variable>(&x))
+      {
+        return *var == needle;
+      } // end if
+
+      auto &op = boost::get<type_operator>(x);
+      for(auto i = op.begin();
+          i != op.end();
+          ++i)
+      {
+        if(occurs(*i, needle, substitution, b)) return true;
+      } // end for i
+
+      return false;
+    } // end occurs()
+
+  private:
+    // if report is false, failure is returned rather than thrown
+    template<typename Iterator, typename Fresh>
+      inline bool run(Iterator first_constraint, Iterator last_constraint, substitution_map &substitution,
+                      Fresh &fresh, const bool report)
+    {
+      m_stack.clear();
+      m_stack.insert(m_stack.end(), first_constraint, last_constraint);
+
+      while(!m_stack.empty())
+      {
+        if(m_budget)
+        {
+          m_budget->charge(budget::unify_iterations);
+        } // end if
+
+        type x = std::move(m_stack.back().first);
+        type y = std::move(m_stack.back().second);
+        m_stack.pop_back();
+
+        if(!solve(walk(x, substitution), walk(y, substitution), substitution, fresh, report))
+        {
+          return false;
+        } // end if
+      } // end while
+
+      return true;
+    } // end run()
+
+    // x and y have been walked
+    template<typename Fresh>
+      inline bool solve(const type &x, const type &y, substitution_map &substitution, Fresh &fresh, const bool report)
+    {
+      auto x_var = boost::get<type_variable>(&x);
+      auto y_var = boost::get<type_variable>(&y);
+
+      if(x_var && y_var)
+      {
+        if(*x_var != *y_var)
+        {
+          substitution.insert(std::make_pair(*x_var, y));
+        } // end if
+      } // end if
+      else if(x_var)
+      {
+        return bind(*x_var, y, substitution, report);
+      } // end else if
+      else if(y_var)
+      {
+        return bind(*y_var, x, substitution, report);
+      } // end else if
+      else
+      {
+        auto &x_op = boost::get<type_operator>(x);
+        auto &y_op = boost::get<type_operator>(y);
+
+        if(!x_op.compare_kind(y_op))
+        {
+          if(is_record(x_op) && is_record(y_op) && detail::unify_records(x_op, y_op, m_stack, &substitution, fresh))
+          {
+            return true;
+          } // end if
+
+          if(!report) return false;
+          throw type_mismatch(resolve(substitution, x), resolve(substitution, y));
+        } // end if
+
+        for(auto xi = x_op.begin(), yi = y_op.begin();
+            xi != x_op.end();
+            ++xi, ++yi)
+        {
+          m_stack.push_back(std::make_pair(*xi, *yi));
+        } // end for xi, yi
+      } // end else
+
+      return true;
+    } // end solve()
+
+    inline bool bind(const type_variable &x, const type &y, substitution_map &substitution, const bool report)
+    {
+      if(occurs(y, x, substitution, m_budget))
+      {
+        if(!report) return false;
+        throw recursive_unification(x, resolve(substitution, y));
+      } // end if
+
+      substitution.insert(std::make_pair(x, y));
+      return true;
+    } // end bind()
+
+    std::vector<constraint, scratch_allocator<constraint>> m_stack;
+    budget                                                *m_budget;
+}; // end workspace
+
 template<typename Range>
-  std::map<type_variable,type>
+  substitution_map
     unify(const Range &rng)
 {
-  std::map<type_variable,type> solutions;
+  substitution_map solutions;
   unify(rng, solutions);
   return std::move(solutions);
 } // end unify()
 
+// returns f(), having called it with resource current
+//
+// the result is copied into the resource which was current before, as are
+// the types carried by type_mismatch and recursive_unification, so that
+// resource may be released as soon as with_resource() returns. the result
+// must be default constructible
+template<typename Function>
+  auto with_resource(std::pmr::memory_resource &resource, Function f)
+    -> decltype(f())
+{
+  decltype(f()) result;
+
+  try
+  {
+    scoped_resource scope(resource);
+    auto r = f();
+
+    scoped_resource outside(scope.previous());
+    result = r;
+  } // end try
+  catch(const type_mismatch &e)
+  {
+    throw type_mismatch(e.x, e.y);
+  } // end catch
+  catch(const recursive_unification &e)
+  {
+    throw recursive_unification(e.x, e.y);
+  } // end catch
+
+  return result;
+} // end with_resource()
+
 } // end unification
 